@@ -0,0 +1,1008 @@
+/*
+ * Headless benchmarks, built with `make Benchmark`.
+ * Results are printed to stdout as CSV.
+ *
+ *   chromakbd_benchmark [render] [frames]
+ *   chromakbd_benchmark rtcheck [blocks]
+ *   chromakbd_benchmark state [rounds]
+ *   chromakbd_benchmark ump [rounds]
+ *   chromakbd_benchmark hittest [positions]
+ *   chromakbd_benchmark scala
+ *   chromakbd_benchmark mpe
+ *   chromakbd_benchmark mts
+ *   chromakbd_benchmark replay file
+ *   chromakbd_benchmark evdev device|recording... [seconds]
+ *   chromakbd_benchmark jack [notes]
+ */
+
+#include <JuceHeader.h>
+#include <jack/jack.h>
+#include <jack/midiport.h>
+#include "ChromaKeyboard.h"
+#include "ChromaRealtimeCheck.h"
+#include "ChromaUmpOutput.h"
+#include "PluginProcessor.h"
+
+namespace
+{
+	// exposes the protected bits needed to repaint a single key or find one
+	class BenchmarkKeyboard : public ChromaKeyboard
+	{
+	public:
+		using ChromaKeyboard::ChromaKeyboard;
+		using ChromaKeyboard::getRectangleForKey;
+		using ChromaKeyboard::findKeyAt;
+
+		// keys of varying width with the odd gap, so findKeyAt() can't
+		// work the key out directly; set before the first resize
+		bool unevenKeys = false;
+
+		juce::Range<float> getKeyPosition(int midiNoteNumber, float targetKeyWidth) const override
+		{
+			if (! unevenKeys)
+				return ChromaKeyboard::getKeyPosition(midiNoteNumber, targetKeyWidth);
+
+			auto getWidth = [&] (int note) { return targetKeyWidth * (1.0f + 0.5f * (float) (note % 3)); };
+			auto getGap = [] (int note) { return note % 4 == 3 ? 1.0f : 0.0f; };
+			auto start = 0.0f;
+			for (int jNote = 0; jNote < midiNoteNumber; jNote++)
+				start += getWidth(jNote) + getGap(jNote);
+			return { start, start + getWidth(midiNoteNumber) };
+		}
+
+		// what findKeyAt() must agree with: every key in turn, positioned
+		// the way the keyboard positions them
+		int findKeyByScan(float x) const
+		{
+			auto width = getKeyWidth();
+			auto start = getKeyPosition(getRangeStart(), width).getStart();
+			for (int jNote = getRangeStart(); jNote <= getRangeEnd(); jNote++)
+				if ((getKeyPosition(jNote, width) - start).contains(x))
+					return jNote;
+			return -1;
+		}
+	};
+
+	struct Timings
+	{
+		double mean = 0, p99 = 0;	// microseconds
+	};
+
+	template <typename Fn>
+	Timings timeFrames(int numFrames, Fn&& renderFrame)
+	{
+		std::vector<double> times;
+		times.reserve((size_t) numFrames);
+
+		for (int jFrame = 0; jFrame < numFrames; jFrame++) {
+			auto start = juce::Time::getHighResolutionTicks();
+			renderFrame(jFrame);
+			auto end = juce::Time::getHighResolutionTicks();
+			times.push_back(juce::Time::highResolutionTicksToSeconds(end - start) * 1.0e6);
+		}
+
+		Timings t;
+		for (auto time: times)
+			t.mean += time;
+		t.mean /= juce::jmax(1, numFrames);
+
+		std::sort(times.begin(), times.end());
+		if (! times.empty())
+			t.p99 = times[(size_t) std::ceil(0.99 * times.size()) - 1];
+		return t;
+	}
+
+	void benchmarkRender(int numFrames)
+	{
+		const int bases[] = { 12, 19, 31, 53, 72 };
+		const float keyWidths[] = { 4.0f, 8.0f, 16.0f, 32.0f };
+		const ChromaKeyboard::Orientation orientations[] = {
+			ChromaKeyboard::horizontal,
+			ChromaKeyboard::verticalFacingLeft,
+			ChromaKeyboard::verticalFacingRight,
+		};
+		const char* orientationNames[] = { "horizontal", "verticalFacingLeft", "verticalFacingRight" };
+		const int pressedCounts[] = { 0, 1, 8, 64 };
+
+		std::cout << "base,keyWidth,orientation,repaint,pressed,frames,mean_us,p99_us" << std::endl;
+
+		for (auto base: bases)
+		for (auto keyWidth: keyWidths)
+		for (int jOrientation = 0; jOrientation < 3; jOrientation++)
+		for (auto numPressed: pressedCounts)
+		for (auto singleKey: { false, true }) {
+			NoteEventQueue events;
+			NoteStateSnapshot noteStates;
+			BenchmarkKeyboard keyboard(events, noteStates, orientations[jOrientation]);
+			keyboard.setBase(base);
+			keyboard.setKeyWidth(keyWidth);
+			if (orientations[jOrientation] == ChromaKeyboard::horizontal)
+				keyboard.setSize(1600, 100);
+			else
+				keyboard.setSize(100, 1600);
+
+			// spread the pressed keys across the whole range
+			juce::MidiBuffer pressed;
+			for (int jKey = 0; jKey < numPressed; jKey++)
+				pressed.addEvent(juce::MidiMessage::noteOn(1, jKey * 128 / numPressed, 1.0f), 0);
+			noteStates.processMidi(pressed);
+			noteStates.publish();
+			keyboard.timerCallback();
+
+			juce::Image target(juce::Image::ARGB, keyboard.getWidth(), keyboard.getHeight(), true);
+
+			// every visible key in turn, for single key repaints
+			juce::Array<int> visibleKeys;
+			for (int jNote = keyboard.getLowestVisibleKey(); jNote <= keyboard.getRangeEnd(); jNote++)
+				if (keyboard.getRectangleForKey(jNote).intersects(keyboard.getLocalBounds().toFloat()))
+					visibleKeys.add(jNote);
+
+			auto renderFrame = [&] (int jFrame) {
+				juce::Graphics g(target);
+				if (singleKey && ! visibleKeys.isEmpty()) {
+					auto note = visibleKeys[jFrame % visibleKeys.size()];
+					g.reduceClipRegion(keyboard.getRectangleForKey(note).getSmallestIntegerContainer());
+				}
+				keyboard.paint(g);
+			};
+
+			// let any caches fill before measuring
+			timeFrames(juce::jmin(numFrames, 10), renderFrame);
+			auto t = timeFrames(numFrames, renderFrame);
+
+			std::cout
+				<< base << ","
+				<< keyWidth << ","
+				<< orientationNames[jOrientation] << ","
+				<< (singleKey ? "single" : "full") << ","
+				<< numPressed << ","
+				<< numFrames << ","
+				<< t.mean << ","
+				<< t.p99 << std::endl;
+		}
+	}
+
+	// restores one saved state into a session's worth of instances
+	void benchmarkStateRestore(int numRounds)
+	{
+		constexpr int numInstances = 256;
+
+		std::vector<std::unique_ptr<ChromakbdAudioProcessor>> instances;
+		for (int j = 0; j < numInstances; j++)
+			instances.push_back(std::make_unique<ChromakbdAudioProcessor>());
+
+		juce::MemoryBlock defaults;
+		instances.front()->getStateInformation(defaults);
+
+		// something other than the defaults, so every record changes a value
+		auto& source = *instances.front();
+		for (auto* parameter: source.getParameters())
+			parameter->setValueNotifyingHost(0.75f);
+		source.setLowestVisibleKey(60);
+		source.setFixedLatencyTiming(true);
+
+		juce::MemoryBlock state;
+		source.getStateInformation(state);
+
+		auto t = timeFrames(numRounds, [&] (int jRound) {
+			// alternate with the defaults, so nothing is already set
+			auto& block = jRound % 2 == 0 ? state : defaults;
+			for (auto& instance: instances)
+				instance->setStateInformation(block.getData(), (int) block.getSize());
+		});
+
+		std::cout << "instances,bytes,rounds,mean_us,p99_us,mean_us_per_instance" << std::endl;
+		std::cout
+			<< numInstances << ","
+			<< state.getSize() << ","
+			<< numRounds << ","
+			<< t.mean << ","
+			<< t.p99 << ","
+			<< t.mean / numInstances << std::endl;
+	}
+
+	// packs a block's worth of notes each way: straight into a MidiBuffer
+	// as MIDI 1.0, as MIDI 2.0 packets, and as packets translated back down
+	void benchmarkUmp(int numRounds)
+	{
+		constexpr int numEvents = ChromakbdAudioProcessor::maxNoteEventsPerBlock;
+
+		std::vector<NoteEventQueue::Event> events;
+		for (int j = 0; j < numEvents; j++)
+			events.push_back({ 1 + (j / 2) % 16, (j / 32) % 128, (float) (j % 97) / 96.0f, j % 2 == 0, 0.0 });
+
+		juce::MidiBuffer midi;
+		midi.ensureSize((size_t) numEvents * ChromakbdAudioProcessor::bytesPerMidiEvent);
+		ChromaUmpOutput ump(numEvents);
+		ump.setBase(31);
+
+		auto midi1 = timeFrames(numRounds, [&] (int) {
+			midi.clear();
+			for (int j = 0; j < numEvents; j++)
+				midi.addEvent(events[(size_t) j].toMidiMessage(), j % 512);
+		});
+		auto packed = timeFrames(numRounds, [&] (int) {
+			ump.clear();
+			for (int j = 0; j < numEvents; j++)
+				ump.process(events[(size_t) j], j % 512);
+		});
+		auto translated = timeFrames(numRounds, [&] (int) {
+			midi.clear();
+			ump.clear();
+			for (int j = 0; j < numEvents; j++)
+				ump.process(events[(size_t) j], j % 512);
+			ump.translateToMidi1(midi);
+		});
+
+		std::cout << "path,events,rounds,mean_us,p99_us,ns_per_event" << std::endl;
+		auto print = [&] (const char* path, const Timings& t) {
+			std::cout
+				<< path << ","
+				<< numEvents << ","
+				<< numRounds << ","
+				<< t.mean << ","
+				<< t.p99 << ","
+				<< t.mean * 1000.0 / numEvents << std::endl;
+		};
+		print("midi1", midi1);
+		print("ump", packed);
+		print("ump_to_midi1", translated);
+	}
+
+	// checks the keyboard's key lookup against a scan of every key at random
+	// positions, for even and uneven keys, and times both
+	int benchmarkHitTest(int numPositions)
+	{
+		const int bases[] = { 12, 31, 53 };
+		const float keyWidths[] = { 4.0f, 7.3f, 16.0f };
+		const juce::Range<int> ranges[] = { { 0, 127 }, { 21, 108 } };
+
+		std::cout << "keys,base,keyWidth,rangeStart,rangeEnd,positions,mismatches,lookup_ns,scan_ns" << std::endl;
+
+		int totalMismatches = 0;
+		juce::Random random(3);
+
+		for (auto uneven: { false, true })
+		for (auto base: bases)
+		for (auto keyWidth: keyWidths)
+		for (auto range: ranges) {
+			NoteEventQueue events;
+			NoteStateSnapshot noteStates;
+			BenchmarkKeyboard keyboard(events, noteStates, ChromaKeyboard::horizontal);
+			keyboard.unevenKeys = uneven;
+			keyboard.setBase(base);
+			keyboard.setKeyWidth(keyWidth);
+			keyboard.setAvailableRange(range.getStart(), range.getEnd());
+			keyboard.setSize(1600, 100);
+
+			// a little past either end, so misses are checked too
+			auto start = keyboard.getKeyPosition(range.getStart(), keyWidth).getStart();
+			auto end = keyboard.getKeyPosition(range.getEnd(), keyWidth).getEnd() - start;
+			std::vector<float> positions;
+			for (int j = 0; j < numPositions; j++)
+				positions.push_back(-8.0f + random.nextFloat() * (end + 16.0f));
+
+			int mismatches = 0;
+			for (auto x: positions)
+				if (keyboard.findKeyAt(x) != keyboard.findKeyByScan(x))
+					mismatches++;
+			totalMismatches += mismatches;
+
+			volatile int sink = 0;
+			auto lookup = timeFrames(1, [&] (int) {
+				for (auto x: positions)
+					sink = sink + keyboard.findKeyAt(x);
+			});
+			auto scan = timeFrames(1, [&] (int) {
+				for (auto x: positions)
+					sink = sink + keyboard.findKeyByScan(x);
+			});
+
+			std::cout
+				<< (uneven ? "uneven" : "even") << ","
+				<< base << ","
+				<< keyWidth << ","
+				<< range.getStart() << ","
+				<< range.getEnd() << ","
+				<< numPositions << ","
+				<< mismatches << ","
+				<< lookup.mean * 1000.0 / numPositions << ","
+				<< scan.mean * 1000.0 / numPositions << std::endl;
+		}
+
+		if (totalMismatches > 0)
+			std::cerr << totalMismatches << " positions found a different key from the scan" << std::endl;
+		return totalMismatches == 0 ? 0 : 1;
+	}
+
+	/*
+	 * Plays a recording of computer key presses into a keyboard, and prints
+	 * the notes it sends. One event per line, with # starting a comment:
+	 *
+	 *   <milliseconds> down|up <key>	a character, or a keycode as a number
+	 *   layout <name>			as in the layout menu
+	 *   keymapbase <note>
+	 */
+	int replayKeys(const juce::File& file)
+	{
+		if (! file.existsAsFile()) {
+			std::cerr << "can't read " << file.getFullPathName() << std::endl;
+			return 1;
+		}
+
+		NoteEventQueue events;
+		NoteStateSnapshot noteStates;
+		BenchmarkKeyboard keyboard(events, noteStates, ChromaKeyboard::horizontal);
+		const juce::StringArray layoutNames { "linear", "guitar", "organ", "harpejji", "hexagonal" };
+
+		std::vector<double> times;
+		std::cout << "time_ms,event,channel,note,velocity" << std::endl;
+
+		juce::StringArray lines;
+		file.readLines(lines);
+		for (int jLine = 0; jLine < lines.size(); jLine++) {
+			auto tokens = juce::StringArray::fromTokens(lines[jLine].upToFirstOccurrenceOf("#", false, false), true);
+			if (tokens.isEmpty())
+				continue;
+
+			if (tokens[0] == "layout" && layoutNames.contains(tokens[1])) {
+				keyboard.setLayout((ChromaKeyMap::Layout) (layoutNames.indexOf(tokens[1]) + 1));
+				continue;
+			}
+			if (tokens[0] == "keymapbase") {
+				keyboard.setKeyMapBase(juce::jlimit(0, 127, tokens[1].getIntValue()));
+				continue;
+			}
+			if (tokens.size() != 3 || (tokens[1] != "down" && tokens[1] != "up")) {
+				std::cerr << file.getFileName() << ":" << jLine + 1 << ": can't parse \"" << lines[jLine] << "\"" << std::endl;
+				return 1;
+			}
+
+			auto keycode = tokens[2].length() == 1 ? (int) tokens[2][0] : tokens[2].getIntValue();
+
+			auto start = juce::Time::getHighResolutionTicks();
+			keyboard.handleKeyTransition(keycode, tokens[1] == "down");
+			auto end = juce::Time::getHighResolutionTicks();
+			times.push_back(juce::Time::highResolutionTicksToSeconds(end - start) * 1.0e6);
+
+			events.popAll([&] (const NoteEventQueue::Event& e) {
+				std::cout
+					<< tokens[0] << ","
+					<< (e.isNoteOn ? "on" : "off") << ","
+					<< e.channel << ","
+					<< e.note << ","
+					<< e.velocity << std::endl;
+			});
+		}
+
+		if (! times.empty()) {
+			std::sort(times.begin(), times.end());
+			auto mean = std::accumulate(times.begin(), times.end(), 0.0) / (double) times.size();
+			std::cerr
+				<< times.size() << " transitions, mean " << mean << " us, p99 "
+				<< times[(size_t) std::ceil(0.99 * times.size()) - 1] << " us" << std::endl;
+		}
+		return 0;
+	}
+
+	// Prints the notes played on input devices, or in recordings of them
+	// made with `cat /dev/input/eventN > recording`, as they come out of
+	// processBlock. The first device follows the parameters; each other one
+	// gets a zone on the next MIDI channel.
+	int readKeys(const juce::Array<juce::File>& devices, double seconds)
+	{
+		constexpr double sampleRate = 48000.0;
+		constexpr int blockSize = 480;	// 10 ms
+
+		ChromakbdAudioProcessor processor;
+		processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+		processor.prepareToPlay(sampleRate, blockSize);
+		processor.setFixedLatencyTiming(true);	// so offsets follow the timestamps
+
+		for (int jDevice = 0; jDevice < juce::jmin(devices.size(), (int) processor.maxKeyReaders); jDevice++) {
+			if (jDevice > 0) {
+				EvdevKeyReader::Zone zone;
+				zone.midiChannel = jDevice + 1;
+				processor.getKeyReader(jDevice).setZone(zone);
+			}
+			auto error = processor.openKeyReader(jDevice, devices[jDevice]);
+			if (error.isNotEmpty()) {
+				std::cerr << error << std::endl;
+				return 1;
+			}
+		}
+
+		auto isReading = [&processor] {
+			for (int jDevice = 0; jDevice < processor.maxKeyReaders; jDevice++)
+				if (processor.isKeyReaderOpen(jDevice))
+					return true;
+			return false;
+		};
+
+		juce::AudioBuffer<float> buffer(processor.getTotalNumOutputChannels(), blockSize);
+		juce::MidiBuffer midi;
+		auto start = juce::Time::getMillisecondCounterHiRes();
+		auto printBlock = [&] (double blockTime) {
+			for (const auto metadata: midi) {
+				auto message = metadata.getMessage();
+				if (! message.isNoteOnOrOff())
+					continue;
+				std::cout
+					<< blockTime - start + metadata.samplePosition * 1000.0 / sampleRate << ","
+					<< (message.isNoteOn() ? "on" : "off") << ","
+					<< message.getChannel() << ","
+					<< message.getNoteNumber() << ","
+					<< message.getFloatVelocity() << std::endl;
+			}
+			midi.clear();
+		};
+
+		std::cout << "time_ms,event,channel,note,velocity" << std::endl;
+		while (isReading() && juce::Time::getMillisecondCounterHiRes() - start < seconds * 1000.0) {
+			auto blockTime = juce::Time::getMillisecondCounterHiRes();
+			processor.processBlock(buffer, midi);
+			printBlock(blockTime);
+			juce::Thread::sleep(10);
+		}
+
+		for (int jDevice = 0; jDevice < processor.maxKeyReaders; jDevice++)
+			processor.closeKeyReader(jDevice);
+
+		// one more maximum-size block of latency drains what was left
+		for (int jBlock = 0; jBlock < 2; jBlock++) {
+			auto blockTime = juce::Time::getMillisecondCounterHiRes();
+			processor.processBlock(buffer, midi);
+			printBlock(blockTime);
+			juce::Thread::sleep(10);
+		}
+		processor.releaseResources();
+		return 0;
+	}
+
+	// The checks print one CSV line per value checked and fail if any is off
+	class CheckResults
+	{
+	public:
+		CheckResults()
+		{
+			std::cout << "check,expected,actual,ok" << std::endl;
+		}
+
+		void check(const juce::String& name, double expected, double actual, double tolerance = 0.0)
+		{
+			auto ok = std::isnan(expected)
+				? std::isnan(actual)
+				: std::abs(actual - expected) <= tolerance;
+			std::cout << name << "," << expected << "," << actual << "," << (ok ? 1 : 0) << std::endl;
+			if (! ok)
+				numFailures++;
+		}
+
+		int finish() const
+		{
+			if (numFailures > 0)
+				std::cerr << numFailures << " checks failed" << std::endl;
+			return numFailures == 0 ? 0 : 1;
+		}
+
+	private:
+		int numFailures = 0;
+	};
+
+	// parses fixed Scala files and checks the pitch each key gets
+	int checkScala()
+	{
+		CheckResults results;
+		auto ratioCents = [] (double ratio) { return 1200.0 * std::log2(ratio); };
+		const auto nan = std::numeric_limits<double>::quiet_NaN();
+
+		// comments, a ratio, cents with a comment after them, cents ending in
+		// a period, and a period written as a whole number with no "/1"
+		const char* scaleText =
+			"! test.scl\n"
+			"!\n"
+			"Ratios and cents\n"
+			" 5\n"
+			"!\n"
+			" 9/8\n"
+			" 300.0 a minor third\n"
+			" 3/2\n"
+			" 1000.\n"
+			" 2\n";
+
+		ChromaScala::Scale scale;
+		auto error = ChromaScala::parseScale(scaleText, scale);
+		results.check("scale parses", 1, error.isEmpty() ? 1 : 0);
+		results.check("scale degrees", 5, (double) scale.cents.size());
+		if (scale.cents.size() == 5) {
+			results.check("degree 1 cents", ratioCents(9.0 / 8.0), scale.cents[0], 1e-9);
+			results.check("degree 2 cents", 300.0, scale.cents[1], 1e-9);
+			results.check("degree 3 cents", ratioCents(1.5), scale.cents[2], 1e-9);
+			results.check("degree 4 cents", 1000.0, scale.cents[3], 1e-9);
+			results.check("period cents", 1200.0, scale.cents[4], 1e-9);
+		}
+
+		// the period's line missing, and a degree that isn't a number
+		ChromaScala::Scale broken;
+		results.check("missing period fails", 1,
+			ChromaScala::parseScale("Short\n 3\n 100.0\n 2/1\n", broken).isNotEmpty() ? 1 : 0);
+		results.check("bad degree fails", 1,
+			ChromaScala::parseScale("Bad\n 2\n abc\n 2/1\n", broken).isNotEmpty() ? 1 : 0);
+
+		// with the standard mapping, key 60 is middle C and each key is the next degree
+		auto standard = ChromaScala::makeTuning(scale, {});
+		auto middleC = 69.0 + 12.0 * std::log2(261.6255653 / 440.0);
+		results.check("standard key 60", middleC, standard->semitones[60], 1e-9);
+		results.check("standard key 61", middleC + ratioCents(9.0 / 8.0) / 100.0, standard->semitones[61], 1e-9);
+		results.check("standard key 64", middleC + 10.0, standard->semitones[64], 1e-9);
+		results.check("standard key 65", middleC + 12.0, standard->semitones[65], 1e-9);
+		results.check("standard key 59", middleC - 2.0, standard->semitones[59], 1e-9);
+
+		// Seven keys to a repeat over a five-degree scale, two of them left
+		// out, repeating at degree 5; A440 on key 69, which plays degree 0
+		// one repeat above the middle note, 62.
+		const char* mappingText =
+			"! test.kbm\n"
+			"7\n"
+			"10\n"
+			"120\n"
+			"62\n"
+			"69\n"
+			"440.0\n"
+			"5\n"
+			"! the keys\n"
+			"0\n"
+			"1\n"
+			"x\n"
+			"2\n"
+			"3\n"
+			"x\n"
+			"4\n";
+
+		ChromaScala::KeyboardMapping mapping;
+		error = ChromaScala::parseKeyboardMapping(mappingText, mapping);
+		results.check("mapping parses", 1, error.isEmpty() ? 1 : 0);
+		results.check("mapping size", 7, mapping.mapSize);
+		results.check("mapping period degree", 5, mapping.periodDegree);
+
+		auto mapped = ChromaScala::makeTuning(scale, mapping);
+		const std::pair<int, double> keys[] = {
+			{ 9, nan },	// below the first note
+			{ 61, 57.0 - 2.0 },	// degree 4 a repeat down
+			{ 62, 57.0 },
+			{ 63, 57.0 + ratioCents(9.0 / 8.0) / 100.0 },
+			{ 64, nan },
+			{ 65, 60.0 },
+			{ 66, 57.0 + ratioCents(1.5) / 100.0 },
+			{ 67, nan },
+			{ 68, 67.0 },
+			{ 69, 69.0 },
+			{ 70, 69.0 + ratioCents(9.0 / 8.0) / 100.0 },
+			{ 121, nan },	// above the last note
+		};
+		for (auto& [key, semitones]: keys)
+			results.check("mapped key " + juce::String(key), semitones, mapped->semitones[(size_t) key], 1e-9);
+		results.check("mapped key 61 degree", 4, mapped->degrees[61]);
+		results.check("mapped key 61 period", -1, mapped->periods[61]);
+		results.check("mapped key 69 period", 1, mapped->periods[69]);
+
+		// the folder browser's quick read, from a file on disk
+		juce::TemporaryFile file(".scl");
+		file.getFile().replaceWithText(scaleText);
+		ChromaScala::IndexEntry entry;
+		results.check("index entry reads", 1, ChromaScala::readIndexEntry(file.getFile(), entry) ? 1 : 0);
+		results.check("index entry notes", 5, entry.numNotes);
+		results.check("index entry description", 1, entry.description == "Ratios and cents" ? 1 : 0);
+
+		return results.finish();
+	}
+
+	// plays overlapping notes through MPE output and checks which channels
+	// they get, which are stolen and how each is bent
+	int checkMpe()
+	{
+		CheckResults results;
+
+		// free channels in the order they were released, then the longest busy
+		ChromaMpeOutput::ChannelAllocator allocator;
+		for (int jChannel = 0; jChannel < ChromaMpeOutput::numMemberChannels; jChannel++)
+			results.check("allocate " + juce::String(jChannel), jChannel, allocator.allocate());
+		allocator.release(7);
+		allocator.release(3);
+		results.check("reuse first released", 7, allocator.allocate());
+		results.check("reuse next released", 3, allocator.allocate());
+		results.check("steal longest busy", 0, allocator.allocate());
+		results.check("steal next longest busy", 1, allocator.allocate());
+
+		// what one event sends, as (status, data) pairs
+		auto getMessages = [] (juce::MidiBuffer& midi) {
+			std::vector<juce::MidiMessage> messages;
+			for (const auto metadata: midi)
+				messages.push_back(metadata.getMessage());
+			midi.clear();
+			return messages;
+		};
+
+		ChromaMpeOutput mpe;
+		juce::MidiBuffer midi;
+
+		// a key held before MPE was on is released as it was played, once
+		NoteStateSnapshot heldNotes;
+		juce::MidiBuffer plain;
+		plain.addEvent(juce::MidiMessage::noteOn(1, 100, 1.0f), 0);
+		heldNotes.processMidi(plain);
+		mpe.start(heldNotes);
+
+		mpe.process({ 1, 100, 0.0f, false, 0.0 }, midi, 0);
+		auto messages = getMessages(midi);
+		results.check("held note off messages", 1, (double) messages.size());
+		if (messages.size() == 1) {
+			results.check("held note off channel", 1, messages[0].getChannel());
+			results.check("held note off note", 100, messages[0].isNoteOff() ? messages[0].getNoteNumber() : -1);
+		}
+		mpe.process({ 1, 100, 0.0f, false, 0.0 }, midi, 0);
+		results.check("second held note off messages", 0, (double) getMessages(midi).size());
+
+		// 17 keys held at once: the first 15 take channels 2 to 16 in turn,
+		// then the 16th and 17th steal channels 2 and 3
+		for (int jKey = 0; jKey < 17; jKey++) {
+			auto key = 40 + jKey;
+			mpe.process({ 1, key, 1.0f, true, 0.0 }, midi, 0);
+			messages = getMessages(midi);
+
+			auto isSteal = jKey >= ChromaMpeOutput::numMemberChannels;
+			auto channel = ChromaMpeOutput::masterChannel + 1 + jKey % ChromaMpeOutput::numMemberChannels;
+			auto name = "key " + juce::String(key);
+			results.check(name + " messages", isSteal ? 3 : 2, (double) messages.size());
+			if (messages.size() != (isSteal ? 3u : 2u))
+				continue;
+
+			if (isSteal) {
+				auto& off = messages[0];
+				results.check(name + " steals channel", channel, off.isNoteOff() ? off.getChannel() : -1);
+				results.check(name + " stops note", key - ChromaMpeOutput::numMemberChannels, off.getNoteNumber());
+			}
+			auto& bend = messages[messages.size() - 2];
+			auto& on = messages.back();
+			results.check(name + " bend channel", channel, bend.isPitchWheel() ? bend.getChannel() : -1);
+			results.check(name + " note on channel", channel, on.isNoteOn() ? on.getChannel() : -1);
+			results.check(name + " note", key, on.getNoteNumber());
+		}
+
+		// stolen keys have nothing left to release; the rest release their channel
+		mpe.process({ 1, 40, 0.0f, false, 0.0 }, midi, 0);
+		results.check("stolen key off messages", 0, (double) getMessages(midi).size());
+		mpe.process({ 1, 42, 0.0f, false, 0.0 }, midi, 0);
+		messages = getMessages(midi);
+		results.check("key 42 off messages", 1, (double) messages.size());
+		if (messages.size() == 1)
+			results.check("key 42 off channel", 4, messages[0].isNoteOff() ? messages[0].getChannel() : -1);
+		mpe.releaseAll(midi, 0);
+		results.check("release all messages", ChromaMpeOutput::numMemberChannels - 1, (double) getMessages(midi).size());
+
+		// 31-EDO: each key's note and bend, turned back into cents, must come
+		// within half a step of the bend's resolution of 1200 / 31 cents a key
+		auto table = ChromaMpeOutput::makeEdoTable(31);
+		auto centsPerWheelStep = ChromaMpeOutput::pitchBendRange * 100.0 / 8192.0;
+		for (int key = 0; key < 128; key++) {
+			auto cents = 6000.0 + 1200.0 * (key - ChromaMpeOutput::anchorNote) / 31.0;
+			auto& pitch = table[(size_t) key];
+			auto name = "31edo key " + juce::String(key);
+			if (cents < -50.0 || cents >= 12750.0) {
+				results.check(name + " left out", -1, pitch.note);
+				continue;
+			}
+			results.check(name + " note", std::round(cents / 100.0), pitch.note);
+			auto sounds = pitch.note * 100.0 + (pitch.pitchWheel - 8192) * centsPerWheelStep;
+			results.check(name + " cents", cents, sounds, centsPerWheelStep / 2.0 + 1e-9);
+		}
+
+		return results.finish();
+	}
+
+	// renders MTS output until a tuning's messages are all out, and checks
+	// their bytes as a synth would read them
+	int checkMts()
+	{
+		CheckResults results;
+		using Message = std::vector<juce::uint8>;
+
+		auto renderTuning = [] (ChromaMtsOutput& mts, size_t numMessages) {
+			std::vector<Message> messages;
+			juce::MidiBuffer midi;
+			// a second at a time, which the link's pace lets through a few messages of
+			for (int jBlock = 0; jBlock < 64 && messages.size() < numMessages; jBlock++) {
+				mts.render(midi, 48000, 48000.0, 1 << 20);
+				for (const auto metadata: midi)
+					messages.emplace_back(metadata.data, metadata.data + metadata.numBytes);
+				midi.clear();
+			}
+			return messages;
+		};
+
+		// a semitone, then 14 bits of fraction, back to semitones
+		auto readFrequency = [] (const Message& bytes, size_t start) {
+			return bytes[start] + ((bytes[start + 1] << 7) | bytes[start + 2]) / 16384.0;
+		};
+		auto isLeftAlone = [] (const Message& bytes, size_t start) {
+			return bytes[start] == 0x7f && bytes[start + 1] == 0x7f && bytes[start + 2] == 0x7f;
+		};
+		const auto fractionTolerance = 0.5 / 16384.0 + 1e-9;
+
+		for (auto base: { 12, 31 }) {
+			auto tag = juce::String(base) + "edo ";
+
+			ChromaMtsOutput bulk;
+			bulk.setTuning(ChromaMtsOutput::bulkDump, base);
+			auto messages = renderTuning(bulk, 1);
+			results.check(tag + "bulk messages", 1, (double) messages.size());
+			if (messages.size() != 1)
+				continue;
+
+			auto& dump = messages[0];
+			results.check(tag + "bulk bytes", 408, (double) dump.size());
+			if (dump.size() != 408)
+				continue;
+
+			const juce::uint8 header[] = { 0xf0, 0x7e, 0x7f, 0x08, 0x01, 0x00 };
+			for (size_t j = 0; j < std::size(header); j++)
+				results.check(tag + "bulk header " + juce::String((int) j), header[j], dump[j]);
+			auto name = juce::String(base) + "-EDO";
+			for (size_t j = 0; j < 16; j++)
+				results.check(tag + "bulk name " + juce::String((int) j), j < (size_t) name.length() ? name[(int) j] : ' ', dump[6 + j]);
+
+			juce::uint8 checksum = 0;
+			for (size_t j = 1; j < 406; j++)
+				checksum ^= dump[j];
+			results.check(tag + "bulk checksum", checksum & 0x7f, dump[406]);
+			results.check(tag + "bulk end", 0xf7, dump[407]);
+
+			for (int key = 0; key < 128; key++) {
+				auto start = 22 + 3 * (size_t) key;
+				auto semitones = 60.0 + 12.0 * (key - 60) / base;
+				results.check(tag + "bulk key " + juce::String(key), semitones, readFrequency(dump, start), fractionTolerance);
+			}
+		}
+
+		// one key worked out by hand: 60 + 12/31 semitones is note 60 and
+		// 0.3871 * 16384 = 6342 = 49 * 128 + 70
+		{
+			ChromaMtsOutput bulk;
+			bulk.setTuning(ChromaMtsOutput::bulkDump, 31);
+			auto messages = renderTuning(bulk, 1);
+			if (messages.size() == 1 && messages[0].size() == 408) {
+				auto start = 22 + 3 * 61;
+				results.check("31edo key 61 byte 0", 60, messages[0][(size_t) start]);
+				results.check("31edo key 61 byte 1", 49, messages[0][(size_t) start + 1]);
+				results.check("31edo key 61 byte 2", 70, messages[0][(size_t) start + 2]);
+			}
+		}
+
+		// real-time changes: 32 keys a message, each key and its frequency
+		ChromaMtsOutput changes;
+		changes.setTuning(ChromaMtsOutput::noteChanges, 31);
+		auto messages = renderTuning(changes, 4);
+		results.check("changes messages", 128 / ChromaMtsOutput::keysPerNoteChange, (double) messages.size());
+		for (size_t jMessage = 0; jMessage < messages.size(); jMessage++) {
+			auto& message = messages[jMessage];
+			auto tag = "changes " + juce::String((int) jMessage) + " ";
+			results.check(tag + "bytes", 8 + 4 * ChromaMtsOutput::keysPerNoteChange, (double) message.size());
+			if (message.size() != 8 + 4 * (size_t) ChromaMtsOutput::keysPerNoteChange)
+				continue;
+
+			const juce::uint8 header[] = { 0xf0, 0x7f, 0x7f, 0x08, 0x02, 0x00, (juce::uint8) ChromaMtsOutput::keysPerNoteChange };
+			for (size_t j = 0; j < std::size(header); j++)
+				results.check(tag + "header " + juce::String((int) j), header[j], message[j]);
+			for (int jKey = 0; jKey < ChromaMtsOutput::keysPerNoteChange; jKey++) {
+				auto start = 7 + 4 * (size_t) jKey;
+				auto key = (int) jMessage * ChromaMtsOutput::keysPerNoteChange + jKey;
+				results.check(tag + "key " + juce::String(jKey), key, message[start]);
+				results.check(tag + "key " + juce::String(key) + " frequency",
+					60.0 + 12.0 * (key - 60) / 31.0, readFrequency(message, start + 1), fractionTolerance);
+			}
+			results.check(tag + "end", 0xf7, message.back());
+		}
+
+		// keys a Scala tuning leaves out are left alone
+		auto tuning = std::make_shared<ChromaScala::Tuning>();
+		tuning->name = "gaps";
+		tuning->semitones.fill(60.5);
+		tuning->semitones[10] = std::numeric_limits<double>::quiet_NaN();
+		ChromaMtsOutput scala;
+		scala.setTuning(ChromaMtsOutput::bulkDump, std::shared_ptr<const ChromaScala::Tuning>(tuning));
+		messages = renderTuning(scala, 1);
+		if (messages.size() == 1 && messages[0].size() == 408) {
+			results.check("scala key 10 left alone", 1, isLeftAlone(messages[0], 22 + 3 * 10) ? 1 : 0);
+			results.check("scala key 11", 60.5, readFrequency(messages[0], 22 + 3 * 11), fractionTolerance);
+		}
+		else {
+			results.check("scala bulk messages", 1, (double) messages.size());
+		}
+
+		return results.finish();
+	}
+
+	// JACK client that notes when each note from the processor's JACK output
+	// comes back, as a time on the JACK clock
+	class JackLoopback
+	{
+	public:
+		std::array<std::atomic<double>, 128> arrivalTimes;	// by note, ms, 0 until it arrives
+
+		juce::String open(const juce::String& sourcePort)
+		{
+			for (auto& time: arrivalTimes)
+				time = 0.0;
+
+			client = jack_client_open("chromakbd_loopback", JackNoStartServer, nullptr);
+			if (client == nullptr)
+				return "can't connect to the JACK server";
+
+			port = jack_port_register(client, "midi_in", JACK_DEFAULT_MIDI_TYPE, JackPortIsInput, 0);
+			jack_set_process_callback(client, [] (jack_nframes_t numFrames, void* self) {
+				static_cast<JackLoopback*>(self)->process(numFrames);
+				return 0;
+			}, this);
+
+			if (port == nullptr || jack_activate(client) != 0)
+				return "can't start the loopback client";
+			if (jack_connect(client, sourcePort.toRawUTF8(), jack_port_name(port)) != 0)
+				return "can't connect " + sourcePort + " to the loopback client";
+			return {};
+		}
+
+		~JackLoopback()
+		{
+			if (client != nullptr) {
+				jack_deactivate(client);
+				jack_client_close(client);
+			}
+		}
+
+	private:
+		void process(jack_nframes_t numFrames)
+		{
+			auto* buffer = jack_port_get_buffer(port, numFrames);
+			auto cycleStart = jack_last_frame_time(client);
+
+			for (juce::uint32 j = 0; j < jack_midi_get_event_count(buffer); j++) {
+				jack_midi_event_t e;
+				if (jack_midi_event_get(&e, buffer, j) != 0 || e.size != 3 || (e.buffer[0] & 0xf0) != 0x90)
+					continue;
+				// when this frame is played, not when this callback runs
+				arrivalTimes[e.buffer[1] & 0x7f] = jack_frames_to_time(client, cycleStart + e.time) / 1000.0;
+			}
+		}
+
+		jack_client_t* client = nullptr;
+		jack_port_t* port = nullptr;
+	};
+
+	// plays notes into the JACK output and prints how long each took to
+	// reach another client; try it with `jackd -d dummy`
+	int benchmarkJackLatency(int numNotes)
+	{
+		ChromakbdAudioProcessor processor;
+		auto error = processor.openJackOutput();
+		JackLoopback loopback;
+		if (error.isEmpty())
+			error = loopback.open(processor.getJackOutputPortName());
+		if (error.isNotEmpty()) {
+			std::cerr << error << std::endl;
+			return 1;
+		}
+
+		std::vector<double> latencies[2];	// as soon as possible, then steady
+		std::cout << "steady_timing,note,latency_ms" << std::endl;
+
+		for (int jNote = 0; jNote < numNotes; jNote++) {
+			// half of them each way, to compare the two timing modes
+			auto steady = jNote >= numNotes / 2;
+			processor.setFixedLatencyTiming(steady);
+
+			auto note = jNote % 128;
+			loopback.arrivalTimes[(size_t) note] = 0.0;
+			auto playedAt = juce::Time::getMillisecondCounterHiRes();
+			processor.uiNoteEvents.push({ 1, note, 1.0f, true, playedAt });
+			processor.uiNoteEvents.push({ 1, note, 1.0f, false, playedAt });
+
+			// a few periods is plenty; then move on to the next
+			juce::Thread::sleep(20);
+			auto arrivedAt = loopback.arrivalTimes[(size_t) note].load();
+			if (arrivedAt == 0.0)
+				continue;
+
+			latencies[steady ? 1 : 0].push_back(arrivedAt - playedAt);
+			std::cout << (steady ? 1 : 0) << "," << note << "," << arrivedAt - playedAt << std::endl;
+		}
+
+		processor.closeJackOutput();
+
+		for (int steady = 0; steady < 2; steady++) {
+			auto& times = latencies[steady];
+			if (times.empty())
+				continue;
+			std::sort(times.begin(), times.end());
+			std::cerr
+				<< (steady ? "steady: " : "as soon as possible: ") << times.size() << " notes arrived, median "
+				<< times[times.size() / 2] << " ms, max " << times.back() << " ms" << std::endl;
+		}
+		return latencies[0].empty() && latencies[1].empty() ? 1 : 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+	juce::String mode = argc > 1 ? argv[1] : "render";
+	int numFrames = argc > 2 ? juce::jmax(1, juce::String(argv[2]).getIntValue()) : 200;
+
+	if (mode == "render") {
+		benchmarkRender(numFrames);
+		return 0;
+	}
+
+	if (mode == "state") {
+		benchmarkStateRestore(numFrames);
+		return 0;
+	}
+
+	if (mode == "ump") {
+		benchmarkUmp(numFrames);
+		return 0;
+	}
+
+	if (mode == "hittest") {
+		int numPositions = argc > 2 ? juce::jmax(1, juce::String(argv[2]).getIntValue()) : 100000;
+		return benchmarkHitTest(numPositions);
+	}
+
+	if (mode == "scala")
+		return checkScala();
+
+	if (mode == "mpe")
+		return checkMpe();
+
+	if (mode == "mts")
+		return checkMts();
+
+	if (mode == "replay") {
+		if (argc < 3) {
+			std::cerr << "usage: chromakbd_benchmark replay file" << std::endl;
+			return 1;
+		}
+		return replayKeys(juce::File::getCurrentWorkingDirectory().getChildFile(argv[2]));
+	}
+
+	if (mode == "evdev") {
+		// devices, then optionally how long to read them for
+		juce::Array<juce::File> devices;
+		auto seconds = 10.0;
+		for (int jArg = 2; jArg < argc; jArg++) {
+			juce::String arg(argv[jArg]);
+			if (jArg == argc - 1 && jArg > 2 && arg.containsOnly("0123456789."))
+				seconds = arg.getDoubleValue();
+			else
+				devices.add(juce::File::getCurrentWorkingDirectory().getChildFile(arg));
+		}
+		if (devices.isEmpty()) {
+			std::cerr << "usage: chromakbd_benchmark evdev device|recording... [seconds]" << std::endl;
+			return 1;
+		}
+		return readKeys(devices, seconds);
+	}
+
+	if (mode == "jack") {
+		int numNotes = argc > 2 ? juce::jmax(1, juce::String(argv[2]).getIntValue()) : 200;
+		return benchmarkJackLatency(numNotes);
+	}
+
+	if (mode == "rtcheck") {
+		int numBlocks = argc > 2 ? juce::jmax(1, juce::String(argv[2]).getIntValue()) : 2000;
+		return runRealtimeCheck(numBlocks) == 0 ? 0 : 1;
+	}
+
+	std::cerr << "unknown benchmark: " << mode << std::endl;
+	return 1;
+}
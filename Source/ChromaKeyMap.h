@@ -0,0 +1,82 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// The keyboard layouts, and the key maps they make: which key each
+// computer key plays. Nothing here needs the GUI, so the processor and the
+// evdev reader can use it without ChromaKeyboard.
+namespace ChromaKeyMap
+{
+	enum Layout
+	{
+		linear = 1,
+		guitar,
+		organ,
+		harpejji,
+		hexagonal,
+	};
+
+	// the keycodes layouts map, ten to a row, from the bottom row of letters
+	// up to the numbers (on a Dvorak keyboard)
+	constexpr char kbdString[41] = ";qjkxbmwvzaoeuidhtns',.pyfgcrl123456789*";
+
+	// keycodes to midi keys, relative to the key map base so that
+	// transposing doesn't touch the map
+	using KeyMap = std::array<int, 256>;
+	constexpr int unmapped = std::numeric_limits<int>::min();
+
+	inline KeyMap makeKeyMap(Layout layout)
+	{
+		KeyMap keyMap;
+		keyMap.fill(unmapped);
+		auto map = [&] (char keycode, int offset) {
+			keyMap[(size_t) (unsigned char) keycode] = offset;
+		};
+
+		if (layout == organ) {
+			// this only really makes sense if the octave size is 12,
+			// but I've tried to make it work roughly logically
+			// even if that isn't the case
+			int x = 0xdead;	// dead keys don't get mapped
+			int blackKeys[7] = { x, 1, 3, x, 6, 8, 10 };
+			int whiteKeys[7] = { 0, 2, 4, 5, 7, 9, 11 };	// an octave is of course *7* white keys
+			for (int jRow = 0; jRow < 4; jRow++) {
+				for (int jCol = 0; jCol < 10; jCol++) {
+					char keycode = kbdString[jRow*10 + jCol];
+					int index = (jRow/2 * 10 + jCol);	// index if the arrays weren't cyclic
+					int offset = (jRow % 2 == 0 ? whiteKeys : blackKeys)[index % 7];
+					if (offset == 0xdead)
+						continue;
+					map(keycode, offset + (index/7)*12);
+				}
+			}
+			return keyMap;
+		}
+
+		int xStep, yStep;
+		switch (layout)
+		{
+		case linear:
+			xStep = 1, yStep = 10;
+			break;
+		case guitar:
+			xStep = 1, yStep = 5;
+			break;
+		case harpejji:
+			xStep = 2, yStep = 1;
+			break;
+		case hexagonal:
+			xStep = 4, yStep = 3;
+			break;
+		default:
+			return keyMap;
+		}
+		for (int jRow = 0; jRow < 4; jRow++) {
+			for (int jCol = 0; jCol < 10; jCol++) {
+				char c = kbdString[jRow*10 + jCol];
+				map(c, jCol*xStep + jRow*yStep);
+			}
+		}
+		return keyMap;
+	}
+}
@@ -42,8 +42,9 @@ private:
 	JUCE_DECLARE_NON_COPYABLE(ChromaKeyboard_ScrollButton)
 };
 
-ChromaKeyboard::ChromaKeyboard(juce::MidiKeyboardState& s, ChromaKeyboard::Orientation o) :
-		state(s),
+ChromaKeyboard::ChromaKeyboard(NoteEventQueue& q, const NoteStateSnapshot& s, ChromaKeyboard::Orientation o) :
+		eventQueue(q),
+		noteStates(s),
 		orientation(o)
 {
 	addAndMakeVisible(layoutSelector);
@@ -51,8 +52,9 @@ ChromaKeyboard::ChromaKeyboard(juce::MidiKeyboardState& s, ChromaKeyboard::Orien
 	layoutSelector.addItemList(layoutNames, 1); // offset must be > 0
 	layoutSelector.onChange = [this] {
 	  setLayout((Layout)layoutSelector.getSelectedId());
+	  if (onLayoutChange)
+		  onLayoutChange();
 	};
-	layoutSelector.setSelectedId(1);
 	addAndMakeVisible(layoutSelectorLabel);
 	layoutSelectorLabel.attachToComponent(&layoutSelector, true);
 
@@ -61,22 +63,27 @@ ChromaKeyboard::ChromaKeyboard(juce::MidiKeyboardState& s, ChromaKeyboard::Orien
 	addChildComponent(scrollDown.get());
 	addChildComponent(scrollUp.get());
 
+	setPalette(ChromaPalette::getDefault());
+
+	// subclasses' getKeyPosition() can't be called yet,
+	// so this is done again on the first resize
+	updateKeyPositions();
+	keyPositionsNeedUpdate = true;
+
 	midiKeysPressed.insertMultiple(0, 0, 256);
-	keycodeToKey.insertMultiple(0, -1, 256);
+	keycodeToKey.insertMultiple(0, ChromaKeyMap::unmapped, 256);
+	keycodeNotes.fill(-1);
 	resetKeycodeStates();
+	setLayout(ChromaKeyMap::linear);
 
 	colourChanged();
 	setWantsKeyboardFocus(true);	// enables recieving keypresses
 
-	state.addListener(this);
-
 	startTimerHz(40);
 }
 
 ChromaKeyboard::~ChromaKeyboard()
-{
-	state.removeListener (this);
-}
+{ }
 
 void ChromaKeyboard::setVelocity(float v, bool useMousePosition)
 {
@@ -109,6 +116,8 @@ void ChromaKeyboard::setKeyWidth(float widthInPixels)
 	// Prevent infinite recursion if the width is being computed in a 'resized()' call-back
 	if (keyWidth != widthInPixels) {
 		keyWidth = widthInPixels;
+		keyPositionsNeedUpdate = true;
+		keyStrip = {};
 		resized();
 	}
 }
@@ -130,6 +139,7 @@ void ChromaKeyboard::setOrientation(ChromaKeyboard::Orientation newOrientation)
 {
 	if (orientation != newOrientation) {
 		orientation = newOrientation;
+		keyStrip = {};
 		resized();
 	}
 }
@@ -146,6 +156,8 @@ void ChromaKeyboard::setAvailableRange(int lowestNote, int highestNote)
 		rangeStart = juce::jlimit (0, 127, lowestNote);
 		rangeEnd = juce::jlimit (0, 127, highestNote);
 		lowestVisibleKey = juce::jlimit ((float) rangeStart, (float) rangeEnd, (float) lowestVisibleKey);
+		keyPositionsNeedUpdate = true;
+		keyStrip = {};
 		resized();
 	}
 }
@@ -188,68 +200,61 @@ int ChromaKeyboard::getNoteAtPosition(juce::Point<float> position)
 void ChromaKeyboard::clearKeyMappings()
 {
 	resetAnyKeysInUse();
-	keycodeToKey.fill(-1);
+	keycodeToKey.fill(ChromaKeyMap::unmapped);
 }
 
 void ChromaKeyboard::mapKeycodeToMidiKey(int keycode, int midiKey)
 {
-	if (rangeStart <= midiKey && midiKey <= rangeEnd)
-		keycodeToKey.set(keycode, midiKey);
-	else
-		unmapKeycode(keycode);
+	keycodeToKey.set(keycode, midiKey - keyMapBase);
 }
 
 void ChromaKeyboard::unmapKeycode(int keycode)
 {
-	keycodeToKey.set(keycode, -1);
+	keycodeToKey.set(keycode, ChromaKeyMap::unmapped);
+}
+
+int ChromaKeyboard::getKeyForKeycode(int keycode) const
+{
+	// keycodes for special keys are well above the table
+	if (! juce::isPositiveAndBelow(keycode, keycodeToKey.size()))
+		return -1;
+	auto offset = keycodeToKey.getUnchecked(keycode);
+	if (offset == ChromaKeyMap::unmapped)
+		return -1;
+	auto midiKey = keyMapBase + offset;
+	return rangeStart <= midiKey && midiKey <= rangeEnd ? midiKey : -1;
 }
 
+// transposes: held keys carry on playing what they started
 void ChromaKeyboard::setKeyMapBase(int newBaseNote)
 {
 	jassert (newBaseNote >= 0 && newBaseNote < 128);
+	if (keyMapBase == newBaseNote)
+		return;
 	keyMapBase = newBaseNote;
-	setLayout(currentLayout);
+	if (onKeyMapBaseChange)
+		onKeyMapBaseChange();
 }
 
+int ChromaKeyboard::getKeyMapBase() const noexcept { return keyMapBase; }
+
 void ChromaKeyboard::shiftKeyMapBase(int offset)
 {
-	setKeyMapBase(keyMapBase+offset);
+	setKeyMapBase(juce::jlimit(0, 127, keyMapBase+offset));
 }
 
 void ChromaKeyboard::setLayout(Layout newLayout)
 {
-	if (newLayout != (Layout)layoutSelector.getSelectedId())
-		layoutSelector.setSelectedId((int)newLayout);
-	int xStep, yStep;
-	switch (newLayout)
-	{
-	case linear:
-		xStep = 1, yStep = 10;
-		break;
-	case guitar:
-		xStep = 1, yStep = 5;
-		break;
-	case organ:
-		setOrganLayout();
-		return;
-	case harpejji:
-		xStep = 2, yStep = 1;
-		break;
-	case hexagonal:
-		xStep = 4, yStep = 3;
-		break;
-	default:
-		return;
-	}
-	clearKeyMappings();
-	for (int jRow = 0; jRow < 4; jRow++) {
-		for (int jCol = 0; jCol < 10; jCol++) {
-			char c = kbdString[jRow*10 + jCol];
-			int midiKey = keyMapBase + jCol*xStep + jRow*yStep;
-			mapKeycodeToMidiKey(c, midiKey);
-		}
-	}
-	currentLayout = newLayout;
+	setKeyMap(newLayout, ChromaKeyMap::makeKeyMap(newLayout));
+}
+
+void ChromaKeyboard::setKeyMap(Layout layout, const KeyMap& keyMap)
+{
+	jassert (keycodeToKey.size() == (int) keyMap.size());
+	// held keys remember what they're playing, so nothing needs cutting off
+	std::copy(keyMap.begin(), keyMap.end(), keycodeToKey.begin());
+	currentLayout = layout;
+	layoutSelector.setSelectedId((int) layout, juce::dontSendNotification);
 }
 
 ChromaKeyboard::Layout ChromaKeyboard::getLayout()
@@ -263,29 +268,105 @@ int ChromaKeyboard::getBase() const
 }
 void ChromaKeyboard::setBase(int newSize)
 {
+	jassert (newSize > 0);
+	if (base == newSize)
+		return;
 	base = newSize;
+	updateNoteColours();
+	labelAtlas.clear();
+	keyPositionsNeedUpdate = true;
+	keyStrip = {};
+	resized();
+}
+
+void ChromaKeyboard::setPalette(std::shared_ptr<ChromaPalette> newPalette)
+{
+	jassert (newPalette != nullptr);
+	if (palette == newPalette)
+		return;
+	palette = std::move(newPalette);
+	updateNoteColours();
+	keyStrip = {};
+	repaint();
+}
+
+void ChromaKeyboard::setTuning(std::shared_ptr<const ChromaScala::Tuning> newTuning)
+{
+	if (tuning == newTuning)
+		return;
+	tuning = std::move(newTuning);
+	updateNoteColours();
+	labelAtlas.clear();
+	keyStrip = {};
 	repaint();
 }
 
+// a tuning's table is per keyboard, but it's only 128 colours
+void ChromaKeyboard::updateNoteColours()
+{
+	if (tuning == nullptr) {
+		noteColours = &palette->getTable(base);
+		return;
+	}
+
+	for (int key = 0; key < (int) tuningColours.size(); key++)
+		tuningColours[(size_t) key] = tuning->degrees[(size_t) key] < 0
+			? juce::Colours::grey
+			: palette->getColourAt(tuning->periodPositions[(size_t) key]);
+	noteColours = &tuningColours;
+}
+
+std::shared_ptr<ChromaPalette> ChromaKeyboard::getPalette() const noexcept { return palette; }
+
 /*
  * Component
  */
 
 void ChromaKeyboard::paint(juce::Graphics& g)
 {
-	auto lineColour = juce::Colour(0x55000000);
-	auto textColour = juce::Colour(0xffFFFFFF);
-	for (float jNote = 0; jNote < 128; jNote ++) {
-		auto noteColour = getNoteColour(jNote, base);
-			drawKey (
-				jNote,
-				g,
-				getRectangleForKey(jNote),
-				state.isNoteOnForChannels(midiInChannelMask, jNote),
-				keyHovered == jNote,
-				noteColour,
-				lineColour,
-				textColour);
+	// the strip is rendered at the physical pixel scale, and offset by the
+	// sub-pixel part of the scroll position so blitting it never resamples
+	auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+	auto origin = getKeyStripOrigin() * scale;
+	auto wholeOrigin = origin.roundToInt();
+	auto phase = origin - wholeOrigin.toFloat();
+
+	if (keyStrip.isNull()
+		|| keyStripScale != scale
+		|| keyStripPhase != phase
+		|| keyStripBounds != getLocalBounds())
+		renderKeyStrip(scale, wholeOrigin);
+
+	g.drawImageTransformed(
+		keyStrip,
+		juce::AffineTransform::translation(wholeOrigin.toFloat()).scaled(1.0f / scale));
+
+	// only the highlighted keys need drawing on top of the strip
+	auto keys = getKeysInArea(g.getClipBounds().toFloat());
+	for (int jNote = keysCurrentlyShownPressed.findNextSetBit(keys.getStart());
+		 jNote >= 0 && jNote < keys.getEnd();
+		 jNote = keysCurrentlyShownPressed.findNextSetBit(jNote + 1)) {
+		drawKey (
+			jNote,
+			g,
+			getRectangleForKey(jNote),
+			true,
+			keyHovered == jNote,
+			(*noteColours)[jNote],
+			keyLineColour,
+			keyTextColour);
+	}
+
+	if (keys.contains(keyHovered) && ! keysCurrentlyShownPressed[keyHovered]) {
+		drawKey (
+			keyHovered,
+			g,
+			getRectangleForKey(keyHovered),
+			false,
+			true,
+			(*noteColours)[keyHovered],
+			keyLineColour,
+			keyTextColour);
 	}
 
 	auto width = getWidth();
@@ -293,7 +374,7 @@ void ChromaKeyboard::paint(juce::Graphics& g)
 
 	auto x = getKeyPos(rangeEnd).getEnd();
 
-	g.setColour(lineColour);
+	g.setColour(keyLineColour);
 
 	// Line at the bottom of keys
 	switch (orientation) {
@@ -315,6 +396,9 @@ void ChromaKeyboard::resized()
 {
 	layoutSelector.setBounds(64, 0, 128, optionBarHeight);
 
+	if (keyPositionsNeedUpdate)
+		updateKeyPositions();
+
 	float w = getWidth();
 	float h = getHeight() - optionBarHeight;
 
@@ -373,6 +457,8 @@ void ChromaKeyboard::resized()
 		scrollUp->setVisible(canScroll && getKeyPos(rangeEnd).getStart() > w);
 		repaint();
 	}
+
+	updateKeyRectangles();
 }
 
 void ChromaKeyboard::mouseMove(const juce::MouseEvent& e)
@@ -433,6 +519,7 @@ void ChromaKeyboard::mouseWheelMove(const juce::MouseEvent& e, const juce::Mouse
 void ChromaKeyboard::colourChanged()
 {
 	setOpaque(true);
+	keyStrip = {};
 	repaint();
 }
 
@@ -440,6 +527,9 @@ void ChromaKeyboard::colourChanged()
 bool ChromaKeyboard::keyPressed(const juce::KeyPress& keypress)
 {
 	int keycode = keypress.getKeyCode();
+	// letters are mapped lower case, as in handleKeyTransition()
+	if ('A' <= keycode && keycode <= 'Z')
+		keycode += 'a' - 'A';
 	if (keycode == juce::KeyPress::escapeKey) {
 		resetAnyKeysInUse();
 		return true;
@@ -451,40 +541,66 @@ bool ChromaKeyboard::keyPressed(const juce::KeyPress& keypress)
 		shiftKeyMapBase(base);
 	} else if (keycode == juce::KeyPress::pageDownKey) {
 		shiftKeyMapBase(-base);
+	} else {
+		handleKeyTransition(keycode, true);
 	}
-	return keycodeToKey[keycode] == -1;
+	return getKeyForKeycode(keycode) == -1;
 }
 
 // called when a keycode is pressed, held or released
-bool ChromaKeyboard::keyStateChanged(bool)
+bool ChromaKeyboard::keyStateChanged(bool isKeyDown)
 {
-	for (char keycode: kbdString) {
-		bool isPressed = juce::KeyPress::isKeyCurrentlyDown(keycode);
-		if (keycodeStates[keycode] != isPressed)
-		{
-			int midiKey = keycodeToKey[keycode];
-			if (isPressed) {
-				// always add note on when key re-pressed
-				state.noteOn(midiChannel, midiKey, velocity);
-				midiKeysPressed.getReference(midiKey)++;
-			} else {
-				midiKeysPressed.getReference(midiKey) = juce::jmax(0,midiKeysPressed[midiKey]-1);
-				if (midiKeysPressed[midiKey] == 0)
-					state.noteOff(midiChannel, midiKey, velocity);
-			}
-			keycodeStates.setBit(keycode, isPressed);
+	// presses arrive through keyPressed(), but a release doesn't say which
+	// key it was, so check just the keys that are held
+	if (! isKeyDown) {
+		for (int keycode = keycodeStates.findNextSetBit(0); keycode >= 0;
+				keycode = keycodeStates.findNextSetBit(keycode + 1)) {
+			if (! juce::KeyPress::isKeyCurrentlyDown(keycode))
+				handleKeyTransition(keycode, false);
 		}
 	}
 	return true;
 }
 
+void ChromaKeyboard::handleKeyTransition(int keycode, bool isDown)
+{
+	if ('A' <= keycode && keycode <= 'Z')
+		keycode += 'a' - 'A';
+	// auto-repeats, and keys outside the table, change nothing
+	if (! juce::isPositiveAndBelow(keycode, (int) keycodeNotes.size()) || keycodeStates[keycode] == isDown)
+		return;
+
+	auto& heldNote = keycodeNotes[(size_t) keycode];
+	if (isDown) {
+		int midiKey = getKeyForKeycode(keycode);
+		if (midiKey >= 0) {
+			// always add note on when key re-pressed
+			sendNoteOn(midiKey, velocity);
+			midiKeysPressed.getReference(midiKey)++;
+		}
+		heldNote = midiKey;
+	} else {
+		// release the note it started, even if it's been remapped since
+		int midiKey = heldNote;
+		if (midiKey >= 0) {
+			midiKeysPressed.getReference(midiKey) = juce::jmax(0,midiKeysPressed[midiKey]-1);
+			if (midiKeysPressed[midiKey] == 0)
+				sendNoteOff(midiKey, velocity);
+		}
+		heldNote = -1;
+	}
+	keycodeStates.setBit(keycode, isDown);
+}
+
 void ChromaKeyboard::focusLost(FocusChangeType cause)
 {
 	resetAnyKeysInUse();
+	keycodeStates.clear();	// we won't hear about releases until focus is back
 	repaint();
 }
 
 void ChromaKeyboard::focusGained(FocusChangeType cause) {
+	resetKeycodeStates();
 	repaint();
 }
 
@@ -494,39 +610,19 @@ void ChromaKeyboard::focusGained(FocusChangeType cause) {
 
 void ChromaKeyboard::timerCallback()
 {
-	if (shouldCheckState) {
-		shouldCheckState = false;
-		for (int jKey = rangeStart; jKey <= rangeEnd; jKey++) {
-			bool isOn = state.isNoteOnForChannels(midiInChannelMask, jKey);
-
-			if (keysCurrentlyShownPressed[jKey] != isOn) {
-				keysCurrentlyShownPressed.setBit(jKey, isOn);
-				repaintKey(jKey);
-			}
-		}
-	}
-}
-
-/*
- * juce::MidiKeyboardState::Listener
- */
+	// nothing to do unless the audio thread has published something new
+	auto version = noteStates.getVersion();
+	if (version == shownNoteStatesVersion && ! shouldCheckState)
+		return;
+	shownNoteStatesVersion = version;
+	shouldCheckState = false;
 
-void ChromaKeyboard::handleNoteOn(
-	juce::MidiKeyboardState*,
-	int midiChan,
-	int midiNoteNumber,
-	float v )
-{
-	shouldCheckState = true;
-}
+	auto notesOn = noteStates.getNotesOn(midiInChannelMask);
+	auto changed = notesOn ^ keysCurrentlyShownPressed;
+	keysCurrentlyShownPressed = notesOn;
 
-void ChromaKeyboard::handleNoteOff(
-	juce::MidiKeyboardState*,
-	int midiChan,
-	int midiNoteNumber,
-	float v )
-{
-	shouldCheckState = true;
+	for (int jKey = changed.findNextSetBit(0); jKey >= 0; jKey = changed.findNextSetBit(jKey + 1))
+		repaintKey(jKey);
 }
 
 void ChromaKeyboard::drawKey(
@@ -549,40 +645,33 @@ void ChromaKeyboard::drawKey(
 	g.setColour(c);
 	g.fillRect(area);
 
-	auto text = getNoteText(midiKeyNumber);
-
-	if (text.isNotEmpty()) {
-		auto fontHeight = juce::jmin(12.0f, keyWidth * 0.9f);
+	juce::Rectangle<float> labelArea;
+	auto justification = juce::Justification::topLeft;
+	switch (orientation) {
+		case horizontal:
+			labelArea = area.withTrimmedLeft(1.0f).withTrimmedBottom(2.0f);
+			break;
+		case verticalFacingLeft:
+			labelArea = area.reduced(2.0f);
+			justification = juce::Justification::topRight;
+			break;
+		case verticalFacingRight:
+			labelArea = area.reduced(2.0f);
+			justification = juce::Justification::bottomLeft;
+			break;
+		default:
+			break;
+	}
 
-		g.setColour(textColour);
-		g.setFont(juce::Font(fontHeight).withHorizontalScale (0.8f));
+	labelAtlas.setStyle(
+		juce::jmin(12.0f, keyWidth * 0.9f),
+		labelArea.getWidth(),
+		g.getInternalContext().getPhysicalPixelScaleFactor() );
+	if (! labelAtlas.contains(midiKeyNumber))
+		labelAtlas.add(midiKeyNumber, getNoteText(midiKeyNumber));
 
-		switch (orientation) {
-			case horizontal:
-				g.drawText(
-					text,
-					area.withTrimmedLeft(1.0f).withTrimmedBottom(2.0f),
-					juce::Justification::topLeft,
-					false );
-				break;
-			case verticalFacingLeft:
-				g.drawText(
-					text,
-					area.reduced(2.0f),
-					juce::Justification::topRight,
-					false );
-				break;
-			case verticalFacingRight:
-				g.drawText(
-					text,
-					area.reduced(2.0f),
-					juce::Justification::bottomLeft,
-					false );
-				break;
-			default:
-				break;
-		}
-	}
+	g.setColour(textColour);
+	labelAtlas.draw(g, midiKeyNumber, labelArea, justification);
 
 	if (! lineColour.isTransparent()) {
 		g.setColour (lineColour);
@@ -622,6 +711,12 @@ void ChromaKeyboard::drawKey(
 
 juce::String ChromaKeyboard::getNoteText(int midiNoteNumber)
 {
+	if (tuning != nullptr) {
+		if (tuning->degrees[(size_t) midiNoteNumber] == 0)
+			return juce::String(tuning->periods[(size_t) midiNoteNumber]);
+		return {};
+	}
+
 	auto octave = midiNoteNumber / base;
 	if (midiNoteNumber % base == 0)
 		return juce::String(octave);
@@ -701,17 +796,19 @@ juce::Range<float> ChromaKeyboard::getKeyPosition(int midiNoteNumber, float targ
 juce::Rectangle<float> ChromaKeyboard::getRectangleForKey(int midiNoteNumber) const
 {
 	jassert (midiNoteNumber >= rangeStart && midiNoteNumber <= rangeEnd);
+	return keyRectangles[midiNoteNumber];
+}
 
-	auto pos = getKeyPos (midiNoteNumber);
-	auto x = pos.getStart();
-	auto w = pos.getLength();
+juce::Point<float> ChromaKeyboard::getKeyStripOrigin() const
+{
+	// where the top left of the strip sits in component space
 	switch (orientation) {
 		case horizontal:
-			return {x, optionBarHeight, w, (float) getHeight()};
+			return { -xOffset, 0.0f };
 		case verticalFacingLeft:
-			return {0, x, (float) getWidth()-optionBarHeight, w};
+			return { 0.0f, -xOffset };
 		case verticalFacingRight:
-			return {optionBarHeight, getHeight() - x - w, (float) getWidth(), w};
+			return { 0.0f, getHeight() - getKeyPos(rangeEnd).getEnd() - 1.0f };
 		default:
 			jassertfalse;
 			break;
@@ -720,26 +817,127 @@ juce::Rectangle<float> ChromaKeyboard::getRectangleForKey(int midiNoteNumber) co
 	return {};
 }
 
-juce::Colour ChromaKeyboard::getNoteColour(int note, int base)
+void ChromaKeyboard::renderKeyStrip(float scale, juce::Point<int> wholeOrigin)
 {
-	float index = (note % base)/(float)base;
-	for (int j = 0; j <= 12; j++) {
-		if (j/13. <= index && index < (j+1)/12.) {
-			float r = (12*index - j);
-			juce::Colour c = juce::Colour(keyColours[j]).interpolatedWith(
-				juce::Colour(keyColours[j+1]),
-				r );
-			return c;
-		}
+	// one pixel either side for the line past the last key and the sub-pixel offset
+	auto length = getKeyPos(rangeEnd).getEnd() - getKeyPos(rangeStart).getStart() + 2.0f;
+	auto w = (orientation == horizontal) ? length : (float) getWidth();
+	auto h = (orientation == horizontal) ? (float) getHeight() : length;
+
+	keyStrip = juce::Image(
+		juce::Image::ARGB,
+		juce::jmax(1, (int) std::ceil(w * scale) + 1),
+		juce::jmax(1, (int) std::ceil(h * scale) + 1),
+		true );
+
+	juce::Graphics g(keyStrip);
+	g.addTransform(juce::AffineTransform::scale(scale)
+		.translated(-wholeOrigin.toFloat()));
+
+	for (int jNote = rangeStart; jNote <= rangeEnd; jNote++) {
+		drawKey (
+			jNote,
+			g,
+			getRectangleForKey(jNote),
+			false,
+			false,
+			(*noteColours)[jNote],
+			keyLineColour,
+			keyTextColour);
+	}
+
+	keyStripScale = scale;
+	keyStripPhase = getKeyStripOrigin() * scale - wholeOrigin.toFloat();
+	keyStripBounds = getLocalBounds();
+}
+
+juce::Range<int> ChromaKeyboard::getKeysInArea(juce::Rectangle<float> area) const
+{
+	// convert the area into a span along the length of the keyboard
+	juce::Range<float> span;
+	switch (orientation) {
+		case horizontal:
+			span = { area.getX(), area.getRight() };
+			break;
+		case verticalFacingLeft:
+			span = { area.getY(), area.getBottom() };
+			break;
+		case verticalFacingRight:
+			span = { getHeight() - area.getBottom(), getHeight() - area.getY() };
+			break;
+		default:
+			jassertfalse;
+			break;
 	}
-	return juce::Colours::black;
+
+	// keys are laid out in ascending order, so binary search for the ends
+	auto firstKeyWhere = [this] (auto predicate) {
+		int lo = rangeStart, hi = rangeEnd + 1;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (predicate(getKeyPos(mid)))
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		return lo;
+	};
+
+	auto first = firstKeyWhere([span] (juce::Range<float> k) { return k.getEnd() > span.getStart(); });
+	auto end   = firstKeyWhere([span] (juce::Range<float> k) { return k.getStart() >= span.getEnd(); });
+
+	return { first, juce::jmax(first, end) };
 }
 
 juce::Range<float> ChromaKeyboard::getKeyPos(int midiNoteNumber) const
 {
-	return getKeyPosition(midiNoteNumber, keyWidth)
-		- xOffset
-		- getKeyPosition(rangeStart, keyWidth).getStart();
+	jassert (midiNoteNumber >= 0 && midiNoteNumber < 128);
+	return keyPositions[midiNoteNumber] - xOffset;
+}
+
+void ChromaKeyboard::updateKeyPositions()
+{
+	auto start = getKeyPosition(rangeStart, keyWidth).getStart();
+	for (int jNote = 0; jNote < 128; jNote++)
+		keyPositions[jNote] = getKeyPosition(jNote, keyWidth) - start;
+
+	// if every key is the same width with no gaps,
+	// the key at a position can be worked out directly
+	uniformKeyWidth = keyPositions[rangeStart].getLength();
+	for (int jNote = rangeStart; jNote <= rangeEnd; jNote++) {
+		auto expectedStart = (jNote - rangeStart) * uniformKeyWidth;
+		auto tolerance = 0.001f * uniformKeyWidth;
+		if (std::abs(keyPositions[jNote].getStart() - expectedStart) > tolerance
+			|| std::abs(keyPositions[jNote].getLength() - uniformKeyWidth) > tolerance) {
+			uniformKeyWidth = 0;
+			break;
+		}
+	}
+
+	keyPositionsNeedUpdate = false;
+}
+
+void ChromaKeyboard::updateKeyRectangles()
+{
+	for (int jNote = 0; jNote < 128; jNote++) {
+		auto pos = getKeyPos(jNote);
+		auto x = pos.getStart();
+		auto w = pos.getLength();
+		switch (orientation) {
+			case horizontal:
+				keyRectangles[jNote] = {x, optionBarHeight, w, (float) getHeight()};
+				break;
+			case verticalFacingLeft:
+				keyRectangles[jNote] = {0, x, (float) getWidth()-optionBarHeight, w};
+				break;
+			case verticalFacingRight:
+				keyRectangles[jNote] = {optionBarHeight, getHeight() - x - w, (float) getWidth(), w};
+				break;
+			default:
+				jassertfalse;
+				break;
+		}
+	}
 }
 
 int ChromaKeyboard::xyToNote(juce::Point<float> pos, float& mousePositionVelocity)
@@ -763,29 +961,59 @@ int ChromaKeyboard::remappedXYToNote(juce::Point<float> pos, float& mousePositio
 	if (pos.y <= optionBarHeight)
 		return -1;
 
-	for (int note = rangeStart; note <= rangeEnd; note++) {
-		if (getKeyPos(note).contains(pos.x - xOffset)) {
-			auto noteLength = ((orientation == horizontal) ? getHeight() : getWidth()) - optionBarHeight;
-			mousePositionVelocity = juce::jmax(0.0f, (pos.y - optionBarHeight)/noteLength);
-			return note;
-		}
+	auto note = findKeyAt(pos.x);
+	if (note >= 0) {
+		auto noteLength = ((orientation == horizontal) ? getHeight() : getWidth()) - optionBarHeight;
+		mousePositionVelocity = juce::jmax(0.0f, (pos.y - optionBarHeight)/noteLength);
+		return note;
 	}
 	mousePositionVelocity = 0;
 	return -1;
 }
 
+int ChromaKeyboard::findKeyAt(float x) const
+{
+	auto note = -1;
+	if (uniformKeyWidth > 0) {
+		// the estimate can only be out by one either way from rounding
+		auto estimate = rangeStart + (int) std::floor(x / uniformKeyWidth);
+		for (int jNote = estimate - 1; jNote <= estimate + 1; jNote++) {
+			if (jNote >= rangeStart && jNote <= rangeEnd && keyPositions[jNote].contains(x)) {
+				note = jNote;
+				break;
+			}
+		}
+	}
+	else {
+		// first key ending after x, which is the only one that can contain it
+		int lo = rangeStart, hi = rangeEnd;
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (keyPositions[mid].getEnd() > x)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		if (keyPositions[lo].contains(x))
+			note = lo;
+	}
+
+	return note;
+}
+
 void ChromaKeyboard::resetAnyKeysInUse()
 {
 	midiKeysPressed.getLock().enter();
 	for (int i = 128; --i >= 0;)
 		if (midiKeysPressed[i]) {
-			state.noteOff(midiChannel, i, 0.0f);
+			sendNoteOff(i, 0.0f);
 			midiKeysPressed.set(i, 0);
 		}
 	midiKeysPressed.getLock().exit();
+	keycodeNotes.fill(-1);
 
 	if (keyClicked >= 0) {
-		state.noteOff(midiChannel, keyClicked, 0.0f);
+		sendNoteOff(keyClicked, 0.0f);
 		keyClicked = -1;
 	}
 	keyHovered = -1;
@@ -806,18 +1034,28 @@ void ChromaKeyboard::updateNoteUnderMouse(juce::Point<float> pos, bool isDown)
 	if (isDown) {
 		if (newKey != keyClicked) {
 			if (keyClicked >= 0)
-				state.noteOff(midiChannel, keyClicked, eventVelocity);
+				sendNoteOff(keyClicked, eventVelocity);
 			if (newKey >= 0)
-				state.noteOn(midiChannel, newKey, eventVelocity);
+				sendNoteOn(newKey, eventVelocity);
 			keyClicked = juce::jmax(newKey, -1);
 		}
 	}
 	else if (keyClicked >= 0) {
-		state.noteOff(midiChannel, keyClicked, eventVelocity);
+		sendNoteOff(keyClicked, eventVelocity);
 		keyClicked = -1;
 	}
 }
 
+void ChromaKeyboard::sendNoteOn(int midiNoteNumber, float v)
+{
+	eventQueue.push({ midiChannel, midiNoteNumber, v, true, juce::Time::getMillisecondCounterHiRes() });
+}
+
+void ChromaKeyboard::sendNoteOff(int midiNoteNumber, float v)
+{
+	eventQueue.push({ midiChannel, midiNoteNumber, v, false, juce::Time::getMillisecondCounterHiRes() });
+}
+
 void ChromaKeyboard::repaintKey(int midiNoteNumber)
 {
 	if (midiNoteNumber >= rangeStart && midiNoteNumber <= rangeEnd)
@@ -836,30 +1074,12 @@ void ChromaKeyboard::setLowestVisibleKeyFloat(float keyNumber)
 	}
 }
 
+// keys already down when we start listening are treated as held, so they
+// don't play anything until they're pressed again
 void ChromaKeyboard::resetKeycodeStates() {
-	for (int jKey = 0; jKey < 256; jKey++) {
-		keycodeStates.setBit(jKey, juce::KeyPress::isKeyCurrentlyDown(jKey));
-	}
-}
-
-void ChromaKeyboard::setOrganLayout() {
-	// this only really makes sense if the octave size is 12,
-	// but I've tried to make it work roughly logically
-	// even if that isn't the case
-	clearKeyMappings();
-	int x = 0xdead;	// dead keys don't get mapped
-	int blackKeys[7] = { x, 1, 3, x, 6, 8, 10 };
-	int whiteKeys[7] = { 0, 2, 4, 5, 7, 9, 11 };	// an octave is of course *7* white keys
-	for (int jRow = 0; jRow < 4; jRow++) {
-		for (int jCol = 0; jCol < 10; jCol++) {
-			char keycode = kbdString[jRow*10 + jCol];
-			int index = (jRow/2 * 10 + jCol);	// index if the arrays weren't cyclic
-			int offset = (jRow % 2 == 0 ? whiteKeys : blackKeys)[index % 7];
-			if (offset == 0xdead)
-				continue;
-			int midiKey = keyMapBase + offset + (index/7)*12;
-			mapKeycodeToMidiKey(keycode, midiKey);
-		}
+	keycodeStates.clear();
+	for (char keycode: ChromaKeyMap::kbdString) {
+		if (keycode != 0)
+			keycodeStates.setBit(keycode, juce::KeyPress::isKeyCurrentlyDown(keycode));
 	}
-	currentLayout = organ;
 }
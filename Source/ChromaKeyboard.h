@@ -1,12 +1,17 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ChromaPalette.h"
+#include "ChromaLabelAtlas.h"
+#include "ChromaKeyMap.h"
+#include "ChromaScala.h"
+#include "NoteEventQueue.h"
+#include "NoteStateSnapshot.h"
 
 class ChromaKeyboard_ScrollButton;
 
 class ChromaKeyboard :
 	public  juce::Component,
-	public  juce::MidiKeyboardState::Listener,
 	public  juce::ChangeBroadcaster,
 	private juce::Timer
 {
@@ -14,7 +19,8 @@ public:
 	friend ChromaKeyboard_ScrollButton;
 
 	const float optionBarHeight = 24.0f;
-	juce::MidiKeyboardState& state;
+	NoteEventQueue& eventQueue;	// what's played
+	const NoteStateSnapshot& noteStates;	// what's displayed
 
 	enum Orientation
 	{
@@ -23,15 +29,9 @@ public:
 		verticalFacingRight,
 	};
 
-	enum Layout
-	{
-		linear = 1,
-		guitar,
-		organ,
-		harpejji,
-		hexagonal,
-	};
-	ChromaKeyboard(juce::MidiKeyboardState& s, Orientation o);
+	using Layout = ChromaKeyMap::Layout;
+	using KeyMap = ChromaKeyMap::KeyMap;
+	ChromaKeyboard(NoteEventQueue& q, const NoteStateSnapshot& s, Orientation o);
 
 	~ChromaKeyboard() override;
 	void setVelocity(float v, bool useMousePosition);
@@ -58,11 +58,28 @@ public:
 	void mapKeycodeToMidiKey(int keycode, int midiKey);
 	void unmapKeycode(int keycode);
 	void setKeyMapBase(int newBaseNote);
+	int getKeyMapBase() const noexcept;
 	void shiftKeyMapBase(int offset);
 	void setLayout(Layout newLayout);
 	Layout getLayout();
+
+	// switches to a key map made earlier by ChromaKeyMap::makeKeyMap(), without cutting off held keys
+	void setKeyMap(Layout layout, const KeyMap& keyMap);
+	// A computer key going down or up, from whichever input sees it first.
+	// Repeats of the current state are ignored, so auto-repeat is harmless.
+	void handleKeyTransition(int keycode, bool isDown);
 	int getBase() const;
 	void setBase(int octave_size);
+	void setPalette(std::shared_ptr<ChromaPalette> newPalette);
+	// colours and labels keys by their place in a Scala tuning rather than
+	// by base; nullptr goes back to base
+	void setTuning(std::shared_ptr<const ChromaScala::Tuning> newTuning);
+	std::shared_ptr<ChromaPalette> getPalette() const noexcept;
+
+	// called when the layout or key map base is changed, from the layout
+	// menu, the arrow keys or a setter
+	std::function<void()> onLayoutChange;
+	std::function<void()> onKeyMapBaseChange;
 
 	/*
 	 * Component
@@ -77,7 +94,7 @@ public:
 	void mouseExit(const juce::MouseEvent& e) override;
 	void mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel) override;
 	void colourChanged() override;
-	bool keyStateChanged(bool) override;
+	bool keyStateChanged(bool isKeyDown) override;
 	bool keyPressed(const juce::KeyPress& keypress) override;
 	void focusLost(FocusChangeType cause) override;
 	void focusGained(FocusChangeType cause) override;
@@ -87,22 +104,6 @@ public:
 	 */
 	void timerCallback() override;
 
-	/*
-	 * MidiKeyboardState::Listener
-	 */
-	void handleNoteOn(
-		juce::MidiKeyboardState*,
-		int midiChan,
-		int midiNoteNumber,
-		float v
-	) override;
-
-	void handleNoteOff(
-		juce::MidiKeyboardState*,
-		int midiChan,
-		int midiNoteNumber,
-		float v
-	) override;
 protected:
 	virtual void drawKey(
 		int midiKeyNumber,
@@ -128,40 +129,33 @@ protected:
 	virtual void mouseUpOnKey(int midiNoteNumber, const juce::MouseEvent& e);
 	virtual juce::Range<float> getKeyPosition(int midiNoteNumber, float targetKeyWidth) const;
 	juce::Rectangle<float> getRectangleForKey(int midiNoteNumber) const;
+	// the key at x along the keyboard, unscrolled, or -1; checked against a
+	// scan of every key by the benchmark's hittest mode
+	int findKeyAt(float x) const;
 
 private:
-	// these have mixed lower and upper case on purpose;
-	// the lowercase "ff" is the alpha channel.
-	const uint32_t keyColours[13] = {
-		0xffF63A45,
-		0xffF58438,
-		0xffF5BC38,
-		0xffC9F538,
-		0xff5EF538,
-		0xff3BF5B7,
-		0xff38B9F5,
-		0xff3880F5,
-		0xff4838F5,
-		0xff9A38F5,
-		0xffD238F5,
-		0xffF538AD,
-		0xffF63A45,
-	};
+	const juce::Colour keyLineColour { 0x55000000 };
+	const juce::Colour keyTextColour { 0xffFFFFFF };
 
-	juce::Colour getNoteColour(int note, int base);
 	juce::Range<float> getKeyPos(int midiNoteNumber) const;
+	void updateKeyPositions();
+	void updateKeyRectangles();
+	juce::Range<int> getKeysInArea(juce::Rectangle<float> area) const;
+	juce::Point<float> getKeyStripOrigin() const;
+	void renderKeyStrip(float scale, juce::Point<int> wholeOrigin);
 	int xyToNote(juce::Point<float> pos, float& mousePositionVelocity);
 	int remappedXYToNote(juce::Point<float> pos, float& mousePositionVelocity) const;
+	int getKeyForKeycode(int keycode) const;	// -1 if it doesn't play a key
 	void resetAnyKeysInUse();
 	void updateNoteUnderMouse(juce::Point<float> pos, bool isDown);
+	void sendNoteOn(int midiNoteNumber, float v);
+	void sendNoteOff(int midiNoteNumber, float v);
 	void repaintKey(int midiNoteNumber);
 	void setLowestVisibleKeyFloat(float keyNumber);
 	void resetKeycodeStates();
-	void setOrganLayout();
 
 	Orientation orientation;
 
-	char kbdString[41] = ";qjkxbmwvzaoeuidhtns',.pyfgcrl123456789*";
 	juce::ComboBox layoutSelector;
 	juce::StringArray layoutNames {
 		"linear",
@@ -174,10 +168,12 @@ private:
 	std::unique_ptr<juce::Button> scrollDown, scrollUp;
 
 	int keyHovered = -1, keyClicked = -1; // -1 indicates no key
-	juce::Array<int> keycodeToKey;	// maps keycodes to midi keys
+	juce::Array<int> keycodeToKey;	// maps keycodes to midi keys, relative to keyMapBase
+	std::array<int, 256> keycodeNotes;	// the midi key each held keycode started, or -1
 	juce::Array<int> midiKeysPressed; 		// midi keys to number of pressers
 	juce::BigInteger keycodeStates; // keeps track of physical keyboard state
-	juce::BigInteger keysCurrentlyShownPressed;
+	NoteStateSnapshot::Notes keysCurrentlyShownPressed;
+	uint32_t shownNoteStatesVersion = 0;
 
 	float velocity = 1.0f;
 	int midiChannel = 1, midiInChannelMask = 0xffff;
@@ -188,10 +184,31 @@ private:
 	int lowestVisibleKey = 48;
 	int keyMapBase = 52;
 	int base = 12;
-	Layout currentLayout = linear;
+	Layout currentLayout = ChromaKeyMap::linear;
+
+	std::shared_ptr<ChromaPalette> palette;
+	const ChromaPalette::Table* noteColours = nullptr;	// palette's table for the current base, or tuningColours
+	std::shared_ptr<const ChromaScala::Tuning> tuning;
+	ChromaPalette::Table tuningColours;
+	void updateNoteColours();
 
 	float xOffset = 0;
 	float keyWidth = 16.0f;
 	float scrollButtonWidth = 12.0f;
+
+	// getKeyPosition() for every note, relative to the start of the range
+	std::array<juce::Range<float>, 128> keyPositions;
+	bool keyPositionsNeedUpdate = true;
+	float uniformKeyWidth = 0;	// 0 if the keys vary in width
+	// where each key is in component space, updated on every resize/scroll
+	std::array<juce::Rectangle<float>, 128> keyRectangles;
+
+	// every key drawn unhighlighted, so paint only has to draw the active ones
+	juce::Image keyStrip;
+	juce::Rectangle<int> keyStripBounds;
+	juce::Point<float> keyStripPhase;
+	float keyStripScale = 0;
+
+	ChromaLabelAtlas labelAtlas;	// getNoteText() for every key, pre-rendered
 };
 
@@ -0,0 +1,78 @@
+#include "ChromaLabelAtlas.h"
+
+void ChromaLabelAtlas::setStyle(float newFontHeight, float newMaxWidth, float newScale)
+{
+	if (fontHeight != newFontHeight || maxWidth != newMaxWidth || scale != newScale) {
+		fontHeight = newFontHeight;
+		maxWidth = newMaxWidth;
+		scale = newScale;
+		font = juce::Font(fontHeight).withHorizontalScale(0.8f);
+		clear();
+	}
+}
+
+void ChromaLabelAtlas::clear()
+{
+	for (auto& label: labels)
+		label = {};
+}
+
+bool ChromaLabelAtlas::contains(int midiNoteNumber) const noexcept
+{
+	jassert (midiNoteNumber >= 0 && midiNoteNumber < 128);
+	return labels[midiNoteNumber].isRendered;
+}
+
+void ChromaLabelAtlas::add(int midiNoteNumber, const juce::String& text)
+{
+	jassert (midiNoteNumber >= 0 && midiNoteNumber < 128);
+	jassert (scale > 0);	// setStyle() hasn't been called
+
+	auto& label = labels[midiNoteNumber];
+	label = {};
+	label.isRendered = true;
+
+	if (text.isEmpty())
+		return;
+
+	// lay out exactly as Graphics::drawText would, without ellipses
+	juce::GlyphArrangement glyphs;
+	glyphs.addCurtailedLineOfText(font, text, 0.0f, 0.0f, maxWidth, false);
+	label.bounds = glyphs.getBoundingBox(0, -1, true);
+
+	if (label.bounds.isEmpty())
+		return;
+
+	label.image = juce::Image(
+		juce::Image::SingleChannel,
+		juce::jmax(1, (int) std::ceil(label.bounds.getWidth() * scale)),
+		juce::jmax(1, (int) std::ceil(label.bounds.getHeight() * scale)),
+		true );
+
+	juce::Graphics g(label.image);
+	g.addTransform(juce::AffineTransform::translation(-label.bounds.getPosition()).scaled(scale));
+	g.setColour(juce::Colours::white);
+	glyphs.draw(g);
+}
+
+void ChromaLabelAtlas::draw(
+	juce::Graphics& g,
+	int midiNoteNumber,
+	juce::Rectangle<float> area,
+	juce::Justification justification ) const
+{
+	jassert (contains(midiNoteNumber));
+
+	auto& label = labels[midiNoteNumber];
+	if (label.image.isNull())
+		return;
+
+	// snap to the pixel grid so the blit doesn't blur the text
+	auto pos = justification.appliedToRectangle(label.bounds.withZeroOrigin(), area).getPosition();
+	pos = (pos * scale).roundToInt().toFloat() / scale;
+
+	g.drawImageTransformed(
+		label.image,
+		juce::AffineTransform::scale(1.0f / scale).translated(pos),
+		true );
+}
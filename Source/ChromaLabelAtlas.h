@@ -0,0 +1,41 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Pre-rasterised note labels, so drawing a key's label is an image blit
+// rather than a font lookup and text layout.
+// Labels are rendered as alpha masks and filled with the current colour
+// when drawn. Changing the font height, the space available or the display
+// scale throws away every label.
+class ChromaLabelAtlas
+{
+public:
+	ChromaLabelAtlas() = default;
+
+	void setStyle(float fontHeight, float maxWidth, float scale);
+	void clear();
+
+	bool contains(int midiNoteNumber) const noexcept;
+	void add(int midiNoteNumber, const juce::String& text);
+
+	void draw(
+		juce::Graphics& g,
+		int midiNoteNumber,
+		juce::Rectangle<float> area,
+		juce::Justification justification ) const;
+
+private:
+	struct Label
+	{
+		juce::Image image;	// empty if there's no text
+		juce::Rectangle<float> bounds;
+		bool isRendered = false;
+	};
+
+	std::array<Label, 128> labels;
+
+	juce::Font font { 12.0f };
+	float fontHeight = 0, maxWidth = 0, scale = 0;
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaLabelAtlas)
+};
@@ -0,0 +1,205 @@
+#include "ChromaMpeOutput.h"
+
+ChromaMpeOutput::TuningTable ChromaMpeOutput::makeEdoTable(int base)
+{
+	jassert (base > 0);
+
+	std::array<double, 128> semitones;
+	for (int key = 0; key < (int) semitones.size(); key++)
+		semitones[(size_t) key] = anchorNote + 12.0 * (key - anchorNote) / base;
+	return makeTable(semitones);
+}
+
+ChromaMpeOutput::TuningTable ChromaMpeOutput::makeTable(const std::array<double, 128>& semitones)
+{
+	TuningTable table;
+	for (int key = 0; key < (int) table.size(); key++) {
+		auto pitch = semitones[(size_t) key];
+		if (! std::isfinite(pitch))
+			continue;
+
+		auto note = (int) std::round(pitch);
+		if (! juce::isPositiveAndBelow(note, 128))
+			continue;
+
+		auto bend = (pitch - note) / pitchBendRange;
+		table[(size_t) key] = { note, juce::jlimit(0, 16383, 8192 + (int) std::round(bend * 8192.0)) };
+	}
+	return table;
+}
+
+ChromaMpeOutput::ChromaMpeOutput()
+{
+	setupMessages = juce::MPEMessages::setLowerZone(numMemberChannels, pitchBendRange);
+	for (auto& keys: voiceForKey)
+		keys.fill(-1);
+	setBase(12);
+}
+
+void ChromaMpeOutput::setBase(int base)
+{
+	auto& table = tables[base];
+	if (table == nullptr)
+		table = std::make_unique<TuningTable>(makeEdoTable(base));
+	tuning = table.get();
+
+	scalaTableTuning = nullptr;
+	retiredTables.retire(std::move(scalaTable));
+}
+
+void ChromaMpeOutput::setTuning(std::shared_ptr<const ChromaScala::Tuning> scalaTuning)
+{
+	jassert (scalaTuning != nullptr);
+	if (scalaTuning == scalaTableTuning) {
+		tuning = scalaTable.get();
+		return;
+	}
+
+	auto table = std::make_unique<TuningTable>(makeTable(scalaTuning->semitones));
+	tuning = table.get();
+
+	scalaTableTuning = std::move(scalaTuning);
+	retiredTables.retire(std::move(scalaTable));
+	scalaTable = std::move(table);
+}
+
+void ChromaMpeOutput::blockDone() noexcept
+{
+	retiredTables.blockDone();
+}
+
+const juce::MidiBuffer& ChromaMpeOutput::getSetupMessages() const noexcept
+{
+	return setupMessages;
+}
+
+void ChromaMpeOutput::start(const NoteStateSnapshot& heldNotes) noexcept
+{
+	for (int channel = 1; channel <= 16; channel++)
+		heldBeforeStart[(size_t) channel - 1] = heldNotes.getHeldNotes(channel);
+}
+
+void ChromaMpeOutput::process(const NoteEventQueue::Event& e, juce::MidiBuffer& midi, int sampleOffset) noexcept
+{
+	if (! juce::isPositiveAndBelow(e.note, 128) || ! juce::isPositiveAndBelow(e.channel - 1, 16))
+		return;
+
+	auto& voiceIndex = voiceForKey[(size_t) e.channel - 1][(size_t) e.note];
+
+	// A key held since before MPE was on is still sounding as it came, so
+	// its release goes out that way too, as does a press that replaces it.
+	// Any other note off without a voice is for one that was stolen or never
+	// played, and the synth has nothing to release.
+	auto& heldBefore = heldBeforeStart[(size_t) e.channel - 1];
+	if (heldBefore[e.note]) {
+		heldBefore.setBit(e.note, false);
+		midi.addEvent(juce::MidiMessage::noteOff(e.channel, e.note, e.isNoteOn ? 0.0f : e.velocity), sampleOffset);
+	}
+	else if (! e.isNoteOn && voiceIndex >= 0) {
+		noteOff(voiceIndex, e.velocity, midi, sampleOffset);
+	}
+
+	if (! e.isNoteOn)
+		return;
+
+	auto& pitch = (*tuning.load())[(size_t) e.note];
+	if (pitch.note < 0)
+		return;
+
+	if (voiceIndex >= 0)
+		noteOff(voiceIndex, 0.0f, midi, sampleOffset);	// pressed again without a release
+
+	auto channelIndex = allocator.allocate();
+	if (voices[(size_t) channelIndex].key >= 0)
+		stopVoice(channelIndex, 0.0f, midi, sampleOffset);	// stolen
+
+	auto memberChannel = masterChannel + 1 + channelIndex;
+	voices[(size_t) channelIndex] = { e.channel, e.note, pitch.note };
+	voiceIndex = (juce::int8) channelIndex;
+
+	// the bend has to arrive first, or the note starts out of tune
+	midi.addEvent(juce::MidiMessage::pitchWheel(memberChannel, pitch.pitchWheel), sampleOffset);
+	midi.addEvent(juce::MidiMessage::noteOn(memberChannel, pitch.note, e.velocity), sampleOffset);
+}
+
+void ChromaMpeOutput::noteOff(int channelIndex, float velocity, juce::MidiBuffer& midi, int sampleOffset) noexcept
+{
+	stopVoice(channelIndex, velocity, midi, sampleOffset);
+	allocator.release(channelIndex);
+}
+
+void ChromaMpeOutput::stopVoice(int channelIndex, float velocity, juce::MidiBuffer& midi, int sampleOffset) noexcept
+{
+	auto& voice = voices[(size_t) channelIndex];
+	midi.addEvent(juce::MidiMessage::noteOff(masterChannel + 1 + channelIndex, voice.note, velocity), sampleOffset);
+
+	voiceForKey[(size_t) voice.sourceChannel - 1][(size_t) voice.key] = -1;
+	voice = {};
+}
+
+void ChromaMpeOutput::releaseAll(juce::MidiBuffer& midi, int sampleOffset) noexcept
+{
+	for (int channelIndex = 0; channelIndex < numMemberChannels; channelIndex++)
+		if (voices[(size_t) channelIndex].key >= 0)
+			noteOff(channelIndex, 0.0f, midi, sampleOffset);
+	allocator.reset();
+}
+
+//==============================================================================
+ChromaMpeOutput::ChannelAllocator::ChannelAllocator()
+{
+	reset();
+}
+
+void ChromaMpeOutput::ChannelAllocator::reset() noexcept
+{
+	freeChannels = {};
+	busyChannels = {};
+	for (int channelIndex = 0; channelIndex < numMemberChannels; channelIndex++) {
+		isBusy[(size_t) channelIndex] = false;
+		append(freeChannels, channelIndex);
+	}
+}
+
+int ChromaMpeOutput::ChannelAllocator::allocate() noexcept
+{
+	auto channelIndex = freeChannels.head >= 0 ? freeChannels.head : busyChannels.head;
+	remove(isBusy[(size_t) channelIndex] ? busyChannels : freeChannels, channelIndex);
+	isBusy[(size_t) channelIndex] = true;
+	append(busyChannels, channelIndex);
+	return channelIndex;
+}
+
+void ChromaMpeOutput::ChannelAllocator::release(int channelIndex) noexcept
+{
+	if (! isBusy[(size_t) channelIndex])
+		return;
+
+	remove(busyChannels, channelIndex);
+	isBusy[(size_t) channelIndex] = false;
+	append(freeChannels, channelIndex);
+}
+
+void ChromaMpeOutput::ChannelAllocator::append(List& list, int channelIndex) noexcept
+{
+	previous[(size_t) channelIndex] = list.tail;
+	next[(size_t) channelIndex] = -1;
+	if (list.tail >= 0)
+		next[(size_t) list.tail] = channelIndex;
+	else
+		list.head = channelIndex;
+	list.tail = channelIndex;
+}
+
+void ChromaMpeOutput::ChannelAllocator::remove(List& list, int channelIndex) noexcept
+{
+	auto before = previous[(size_t) channelIndex], after = next[(size_t) channelIndex];
+	if (before >= 0)
+		next[(size_t) before] = after;
+	else
+		list.head = after;
+	if (after >= 0)
+		previous[(size_t) after] = before;
+	else
+		list.tail = before;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "NoteEventQueue.h"
+#include "NoteStateSnapshot.h"
+#include "ChromaScala.h"
+#include "ChromaRetiredList.h"
+
+// Turns key events into MPE, so an N-EDO layout sounds in tune on any MPE
+// synth. Each key is played on a member channel of its own, with a pitch
+// bend that moves the nearest 12-TET note to the key's N-EDO pitch.
+// Key 60 plays middle C whatever the base; each key up or down is one step
+// of 1200 / base cents. A Scala tuning replaces that with its own pitches.
+// Tuning tables are built on the message thread, once per base; the audio
+// thread only looks them up.
+class ChromaMpeOutput
+{
+public:
+	static constexpr int masterChannel = 1;
+	static constexpr int numMemberChannels = 15;	// channels 2 to 16, the whole lower zone
+	static constexpr int pitchBendRange = 48;	// semitones, the MPE default for member channels
+	static constexpr int anchorNote = 60;
+
+	// a note off for a key held from before MPE was on, a note off for a
+	// stolen channel, a pitch bend and a note on
+	static constexpr int maxMessagesPerEvent = 4;
+
+	struct Pitch
+	{
+		int note = -1;	// the nearest 12-TET note, -1 if it's out of the MIDI range
+		int pitchWheel = 8192;
+	};
+	using TuningTable = std::array<Pitch, 128>;	// by key
+
+	static TuningTable makeEdoTable(int base);
+	static TuningTable makeTable(const std::array<double, 128>& semitones);	// NaN for keys left out
+
+	ChromaMpeOutput();
+
+	// message thread
+	void setBase(int base);
+	void setTuning(std::shared_ptr<const ChromaScala::Tuning> tuning);
+
+	// audio thread
+	// the MPE configuration messages, sent when MPE output is turned on
+	const juce::MidiBuffer& getSetupMessages() const noexcept;
+	// when MPE output is turned on, with the notes the output still holds
+	// from before: only their note offs go out as they came
+	void start(const NoteStateSnapshot& heldNotes) noexcept;
+	void process(const NoteEventQueue::Event& e, juce::MidiBuffer& midi, int sampleOffset) noexcept;
+	void releaseAll(juce::MidiBuffer& midi, int sampleOffset) noexcept;
+	// after each block, so replaced Scala tables can be freed
+	void blockDone() noexcept;
+
+	// Member channels, each in one of two lists: free ones in the order they
+	// were released and busy ones in the order they were taken, so finding
+	// the channel to use next is O(1) however many are in use.
+	class ChannelAllocator
+	{
+	public:
+		ChannelAllocator();
+
+		// the least recently released free channel, or if none are free,
+		// the one that has been busy longest
+		int allocate() noexcept;
+		void release(int channelIndex) noexcept;
+		void reset() noexcept;
+
+	private:
+		struct List
+		{
+			int head = -1, tail = -1;
+		};
+		void append(List& list, int channelIndex) noexcept;
+		void remove(List& list, int channelIndex) noexcept;
+
+		std::array<int, numMemberChannels> previous, next;
+		std::array<bool, numMemberChannels> isBusy;
+		List freeChannels, busyChannels;
+	};
+
+private:
+	void noteOff(int channelIndex, float velocity, juce::MidiBuffer& midi, int sampleOffset) noexcept;
+	void stopVoice(int channelIndex, float velocity, juce::MidiBuffer& midi, int sampleOffset) noexcept;	// keeps the channel
+
+	// message thread only. N-EDO tables are few and never freed; only the
+	// current Scala tuning's is kept, and a replaced one is freed once the
+	// audio thread is done with it.
+	std::map<int, std::unique_ptr<TuningTable>> tables;
+	std::unique_ptr<TuningTable> scalaTable;
+	std::shared_ptr<const ChromaScala::Tuning> scalaTableTuning;	// what scalaTable was made from
+	ChromaRetiredList<TuningTable> retiredTables;
+	std::atomic<const TuningTable*> tuning { nullptr };
+
+	juce::MidiBuffer setupMessages;
+
+	// audio thread only
+	struct Voice
+	{
+		int sourceChannel = -1, key = -1;	// what's playing it, -1 if nothing
+		int note = -1;
+	};
+	std::array<Voice, numMemberChannels> voices;
+	std::array<std::array<juce::int8, 128>, 16> voiceForKey;	// by source channel and key, -1 if none
+	std::array<NoteStateSnapshot::Notes, 16> heldBeforeStart;	// by source channel
+	ChannelAllocator allocator;
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaMpeOutput)
+};
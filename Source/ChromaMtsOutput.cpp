@@ -0,0 +1,168 @@
+#include "ChromaMtsOutput.h"
+
+double ChromaMtsOutput::getSemitones(int base, int key)
+{
+	jassert (base > 0);
+	return anchorNote + 12.0 * (key - anchorNote) / base;
+}
+
+void ChromaMtsOutput::setTuning(Mode mode, int base)
+{
+	if (mode == off) {
+		publish(nullptr);
+		return;
+	}
+
+	auto& dump = dumps[{ (int) mode, base }];
+	if (dump == nullptr) {
+		dump = makeDump(mode, getEdoSemitones(base), juce::String(base) + "-EDO");
+		dump->id = ++numDumpsMade;
+	}
+	publish(dump.get());
+}
+
+void ChromaMtsOutput::setTuning(Mode mode, std::shared_ptr<const ChromaScala::Tuning> tuning)
+{
+	jassert (tuning != nullptr);
+	if (mode == off) {
+		publish(nullptr);
+		return;
+	}
+
+	if (tuning == scalaDumpTuning && mode == scalaDumpMode) {
+		current = scalaDump.get();
+		return;
+	}
+
+	auto dump = makeDump(mode, tuning->semitones, tuning->name);
+	dump->id = ++numDumpsMade;
+	current = dump.get();
+
+	retiredDumps.retire(std::move(scalaDump));
+	scalaDump = std::move(dump);
+	scalaDumpTuning = std::move(tuning);
+	scalaDumpMode = mode;
+}
+
+// an N-EDO dump or none, so the Scala one can go
+void ChromaMtsOutput::publish(const Dump* dump)
+{
+	current = dump;
+	scalaDumpTuning = nullptr;
+	retiredDumps.retire(std::move(scalaDump));
+}
+
+void ChromaMtsOutput::render(juce::MidiBuffer& midi, int numSamples, double sampleRate, int byteBudget) noexcept
+{
+	auto* dump = current.load();
+	auto id = dump != nullptr ? dump->id : 0;
+	if (id != sendingId) {
+		// a new tuning: start again from its first message, straight away
+		sending = dump;
+		sendingId = id;
+		nextMessage = 0;
+		allowance = maxMessageBytes;
+	}
+	if (sending == nullptr)
+		return;
+
+	allowance = juce::jmin((double) maxMessageBytes, allowance + numSamples * bytesPerSecond / sampleRate);
+
+	while (nextMessage + 1 < sending->messageStarts.size()) {
+		auto start = sending->messageStarts[nextMessage];
+		auto size = sending->messageStarts[nextMessage + 1] - start;
+		auto bytesNeeded = (int) (sizeof(int32_t) + sizeof(uint16_t)) + size;
+		if (size > allowance || midi.data.size() + bytesNeeded > byteBudget)
+			break;
+
+		midi.addEvent(sending->bytes.data() + start, size, 0);
+		allowance -= size;
+		nextMessage++;
+	}
+}
+
+void ChromaMtsOutput::blockDone() noexcept
+{
+	retiredDumps.blockDone();
+}
+
+ChromaMtsOutput::Semitones ChromaMtsOutput::getEdoSemitones(int base)
+{
+	Semitones semitones;
+	for (int key = 0; key < (int) semitones.size(); key++)
+		semitones[(size_t) key] = getSemitones(base, key);
+	return semitones;
+}
+
+std::unique_ptr<ChromaMtsOutput::Dump> ChromaMtsOutput::makeDump(Mode mode, const Semitones& semitones, const juce::String& name)
+{
+	return mode == bulkDump ? makeBulkDump(semitones, name) : makeNoteChanges(semitones);
+}
+
+// 0xf0 0x7e <device> 0x08 0x01 <program> <16 byte name> <128 frequencies> <checksum> 0xf7
+std::unique_ptr<ChromaMtsOutput::Dump> ChromaMtsOutput::makeBulkDump(const Semitones& semitones, const juce::String& name)
+{
+	auto dump = std::make_unique<Dump>();
+	auto& bytes = dump->bytes;
+	bytes.reserve(bulkDumpBytes);
+	dump->messageStarts.push_back(0);
+
+	for (auto b: { 0xf0, 0x7e, 0x7f, 0x08, 0x01, 0x00 })
+		bytes.push_back((juce::uint8) b);
+
+	auto paddedName = name.paddedRight(' ', 16).substring(0, 16);
+	for (int j = 0; j < 16; j++)
+		bytes.push_back((juce::uint8) (paddedName[j] & 0x7f));
+
+	for (int key = 0; key < 128; key++)
+		appendFrequency(bytes, semitones[(size_t) key]);
+
+	// the checksum covers everything between 0xf0 and itself
+	juce::uint8 checksum = 0;
+	for (size_t j = 1; j < bytes.size(); j++)
+		checksum ^= bytes[j];
+	bytes.push_back(checksum & 0x7f);
+	bytes.push_back(0xf7);
+
+	jassert (bytes.size() == (size_t) bulkDumpBytes);
+	dump->messageStarts.push_back((int) bytes.size());
+	return dump;
+}
+
+// 0xf0 0x7f <device> 0x08 0x02 <program> <count> (<key> <frequency>)... 0xf7
+std::unique_ptr<ChromaMtsOutput::Dump> ChromaMtsOutput::makeNoteChanges(const Semitones& semitones)
+{
+	auto dump = std::make_unique<Dump>();
+	auto& bytes = dump->bytes;
+
+	for (int firstKey = 0; firstKey < 128; firstKey += keysPerNoteChange) {
+		dump->messageStarts.push_back((int) bytes.size());
+		for (auto b: { 0xf0, 0x7f, 0x7f, 0x08, 0x02, 0x00, keysPerNoteChange })
+			bytes.push_back((juce::uint8) b);
+
+		for (int key = firstKey; key < firstKey + keysPerNoteChange; key++) {
+			bytes.push_back((juce::uint8) key);
+			appendFrequency(bytes, semitones[(size_t) key]);
+		}
+		bytes.push_back(0xf7);
+	}
+
+	dump->messageStarts.push_back((int) bytes.size());
+	return dump;
+}
+
+// a semitone, then 14 bits of fraction of a semitone;
+// 0x7f 0x7f 0x7f means "leave this key alone"
+void ChromaMtsOutput::appendFrequency(std::vector<juce::uint8>& bytes, double semitones)
+{
+	auto units = std::isfinite(semitones) ? std::round(semitones * 16384.0) : -1.0;
+	if (units < 0 || units >= 128 * 16384 - 1) {
+		bytes.insert(bytes.end(), { 0x7f, 0x7f, 0x7f });
+		return;
+	}
+
+	auto value = (int) units;
+	bytes.push_back((juce::uint8) (value >> 14));
+	bytes.push_back((juce::uint8) ((value >> 7) & 0x7f));
+	bytes.push_back((juce::uint8) (value & 0x7f));
+}
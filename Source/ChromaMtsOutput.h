@@ -0,0 +1,81 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChromaScala.h"
+#include "ChromaMpeOutput.h"
+#include "ChromaRetiredList.h"
+
+// Retunes a synth with MIDI Tuning Standard SysEx, for synths that take
+// tuning messages but not MPE. Notes go out as played; the synth is told
+// to tune key 60 to middle C, as MPE output does, and each key away from it
+// by 1200 / base cents per step, or to a Scala tuning. The anchor stays put
+// when the key map scrolls, so scrolling never retunes the synth.
+// The messages for each tuning are built once on the message thread and
+// cached. The audio thread copies them out, no faster than a DIN MIDI link
+// carries them, so a retune never floods a slow link in one block.
+class ChromaMtsOutput
+{
+public:
+	enum Mode
+	{
+		off,
+		bulkDump,	// one non-real-time dump of all 128 keys
+		noteChanges,	// real-time single note tuning changes, a few keys per message
+	};
+
+	static constexpr int bytesPerSecond = 3125;	// 31250 baud, ten bits a byte
+	static constexpr int bulkDumpBytes = 408;
+	static constexpr int keysPerNoteChange = 32;
+	static constexpr int maxMessageBytes = bulkDumpBytes;
+
+	// where a key is tuned to, in semitones above MIDI note 0
+	static constexpr int anchorNote = ChromaMpeOutput::anchorNote;
+	static double getSemitones(int base, int key);
+
+	ChromaMtsOutput() = default;
+
+	// message thread
+	void setTuning(Mode mode, int base);
+	void setTuning(Mode mode, std::shared_ptr<const ChromaScala::Tuning> tuning);
+
+	// audio thread: adds whatever is due of the current tuning's messages
+	void render(juce::MidiBuffer& midi, int numSamples, double sampleRate, int byteBudget) noexcept;
+	// after each block, rendered or not, so replaced Scala dumps can be freed
+	void blockDone() noexcept;
+
+private:
+	// every message of one tuning, back to back
+	struct Dump
+	{
+		std::vector<juce::uint8> bytes;
+		std::vector<int> messageStarts;	// and bytes.size() at the end
+		juce::uint32 id = 0;	// never reused, unlike a freed dump's address
+	};
+	using Semitones = std::array<double, 128>;	// NaN for keys left alone
+	static Semitones getEdoSemitones(int base);
+	static std::unique_ptr<Dump> makeDump(Mode mode, const Semitones& semitones, const juce::String& name);
+	static std::unique_ptr<Dump> makeBulkDump(const Semitones& semitones, const juce::String& name);
+	static std::unique_ptr<Dump> makeNoteChanges(const Semitones& semitones);
+	static void appendFrequency(std::vector<juce::uint8>& bytes, double semitones);
+
+	void publish(const Dump* dump);
+
+	// message thread only. N-EDO dumps are few and never freed; only the
+	// current Scala tuning's is kept, and a replaced one is freed once the
+	// audio thread is done with it.
+	std::map<std::pair<int, int>, std::unique_ptr<Dump>> dumps;	// by mode and base
+	std::unique_ptr<Dump> scalaDump;
+	std::shared_ptr<const ChromaScala::Tuning> scalaDumpTuning;	// what scalaDump was made from
+	Mode scalaDumpMode = off;
+	ChromaRetiredList<Dump> retiredDumps;
+	juce::uint32 numDumpsMade = 0;
+	std::atomic<const Dump*> current { nullptr };
+
+	// audio thread only
+	const Dump* sending = nullptr;
+	juce::uint32 sendingId = 0;
+	size_t nextMessage = 0;
+	double allowance = 0;	// bytes the link could have carried by now
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaMtsOutput)
+};
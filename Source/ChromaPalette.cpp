@@ -0,0 +1,134 @@
+#include "ChromaPalette.h"
+
+namespace
+{
+	struct Oklab
+	{
+		float L, a, b;
+	};
+
+	float toLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float fromLinear(float c)
+	{
+		c = juce::jlimit(0.0f, 1.0f, c);
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	}
+
+	// see https://bottosson.github.io/posts/oklab/
+	Oklab toOklab(juce::Colour c)
+	{
+		auto r = toLinear(c.getFloatRed());
+		auto g = toLinear(c.getFloatGreen());
+		auto b = toLinear(c.getFloatBlue());
+
+		auto l = std::cbrt(0.4122214708f*r + 0.5363325363f*g + 0.0514459929f*b);
+		auto m = std::cbrt(0.2119034982f*r + 0.6806995451f*g + 0.1073969566f*b);
+		auto s = std::cbrt(0.0883024619f*r + 0.2817188376f*g + 0.6299787005f*b);
+
+		return {
+			0.2104542553f*l + 0.7936177850f*m - 0.0040720468f*s,
+			1.9779984951f*l - 2.4285922050f*m + 0.4505937099f*s,
+			0.0259040371f*l + 0.7827717662f*m - 0.8086757660f*s,
+		};
+	}
+
+	juce::Colour fromOklab(Oklab c, float alpha)
+	{
+		auto l = c.L + 0.3963377774f*c.a + 0.2158037573f*c.b;
+		auto m = c.L - 0.1055613458f*c.a - 0.0638541728f*c.b;
+		auto s = c.L - 0.0894841775f*c.a - 1.2914855480f*c.b;
+		l = l*l*l, m = m*m*m, s = s*s*s;
+
+		return juce::Colour::fromFloatRGBA(
+			fromLinear( 4.0767416621f*l - 3.3077115913f*m + 0.2309699292f*s),
+			fromLinear(-1.2684380046f*l + 2.6097574011f*m - 0.3413193965f*s),
+			fromLinear(-0.0041960863f*l - 0.7034186147f*m + 1.7076147010f*s),
+			alpha );
+	}
+}
+
+ChromaPalette::ChromaPalette(juce::Array<Stop> gradientStops, Interpolation i) :
+		stops(std::move(gradientStops)),
+		interpolation(i)
+{
+	jassert (! stops.isEmpty());
+	std::stable_sort(stops.begin(), stops.end(), [] (const Stop& a, const Stop& b) {
+		return a.position < b.position;
+	});
+}
+
+std::shared_ptr<ChromaPalette> ChromaPalette::getDefault()
+{
+	// these have mixed lower and upper case on purpose;
+	// the lowercase "ff" is the alpha channel.
+	const uint32_t keyColours[13] = {
+		0xffF63A45,
+		0xffF58438,
+		0xffF5BC38,
+		0xffC9F538,
+		0xff5EF538,
+		0xff3BF5B7,
+		0xff38B9F5,
+		0xff3880F5,
+		0xff4838F5,
+		0xff9A38F5,
+		0xffD238F5,
+		0xffF538AD,
+		0xffF63A45,
+	};
+
+	static auto palette = [&] {
+		juce::Array<Stop> s;
+		for (int j = 0; j < 13; j++)
+			s.add({ j / 12.0f, juce::Colour(keyColours[j]) });
+		return std::make_shared<ChromaPalette>(s);
+	}();
+
+	return palette;
+}
+
+const ChromaPalette::Table& ChromaPalette::getTable(int base)
+{
+	jassert (base > 0);
+	const juce::ScopedLock sl(tableLock);
+
+	auto& table = tables[base];
+	if (table == nullptr) {
+		table.reset(new Table());
+		for (int jNote = 0; jNote < 128; jNote++)
+			(*table)[jNote] = getColourAt((jNote % base)/(float)base);
+	}
+	return *table;
+}
+
+juce::Colour ChromaPalette::getColourAt(float position) const
+{
+	if (position <= stops.getFirst().position)
+		return stops.getFirst().colour;
+
+	for (int j = 1; j < stops.size(); j++) {
+		auto& next = stops.getReference(j);
+		if (position < next.position) {
+			auto& prev = stops.getReference(j-1);
+			float r = (position - prev.position)/(next.position - prev.position);
+
+			if (interpolation == rgb)
+				return prev.colour.interpolatedWith(next.colour, r);
+
+			auto a = toOklab(prev.colour), b = toOklab(next.colour);
+			return fromOklab(
+				{ a.L + (b.L - a.L)*r, a.a + (b.a - a.a)*r, a.b + (b.b - a.b)*r },
+				prev.colour.getFloatAlpha() + (next.colour.getFloatAlpha() - prev.colour.getFloatAlpha())*r );
+		}
+	}
+	return stops.getLast().colour;
+}
+
+ChromaPalette::Interpolation ChromaPalette::getInterpolation() const noexcept
+{
+	return interpolation;
+}
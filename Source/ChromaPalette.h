@@ -0,0 +1,45 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// A gradient of colours across one octave, compiled into a table of
+// colours for all 128 midi notes for each base it is used with.
+// Palettes are shared, so every keyboard using the same palette and base
+// reads the same table.
+class ChromaPalette
+{
+public:
+	enum Interpolation
+	{
+		rgb,
+		oklab,	// perceptually uniform
+	};
+
+	struct Stop
+	{
+		float position;	// 0 is the start of the octave, 1 is the end
+		juce::Colour colour;
+	};
+
+	using Table = std::array<juce::Colour, 128>;
+
+	ChromaPalette(juce::Array<Stop> gradientStops, Interpolation i = rgb);
+
+	static std::shared_ptr<ChromaPalette> getDefault();
+
+	// built on first use, after which the reference stays valid for the
+	// lifetime of the palette
+	const Table& getTable(int base);
+
+	juce::Colour getColourAt(float position) const;
+	Interpolation getInterpolation() const noexcept;
+
+private:
+	juce::Array<Stop> stops;
+	Interpolation interpolation;
+
+	juce::CriticalSection tableLock;
+	std::map<int, std::unique_ptr<Table>> tables;
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaPalette)
+};
@@ -0,0 +1,38 @@
+#include "ChromaProgramBank.h"
+
+ChromaProgramBank ChromaProgramBank::createFactoryBank()
+{
+	ChromaProgramBank bank;
+	auto palette = ChromaPalette::getDefault();
+
+	//           name              base  layout                       keyMapBase, range, channel
+	bank.add({ "12 guitar",        12,   ChromaKeyMap::guitar,      52, 0, 127, 1, palette });
+	bank.add({ "12 organ",         12,   ChromaKeyMap::organ,       48, 0, 127, 1, palette });
+	bank.add({ "12 linear",        12,   ChromaKeyMap::linear,      48, 0, 127, 1, palette });
+	bank.add({ "19 harpejji",      19,   ChromaKeyMap::harpejji,    76, 0, 127, 1, palette });
+	bank.add({ "31 hexagonal",     31,   ChromaKeyMap::hexagonal,   62, 0, 127, 1, palette });
+	bank.add({ "53 hexagonal",     53,   ChromaKeyMap::hexagonal,   53, 0, 127, 1, palette });
+	return bank;
+}
+
+void ChromaProgramBank::add(Program program)
+{
+	jassert (program.palette != nullptr);
+	program.keyMap = ChromaKeyMap::makeKeyMap(program.layout);
+	program.palette->getTable(program.base);	// so it's cached before it's needed
+	programs.push_back(std::move(program));
+}
+
+int ChromaProgramBank::size() const noexcept { return (int) programs.size(); }
+
+const ChromaProgramBank::Program& ChromaProgramBank::operator[](int index) const noexcept
+{
+	jassert (index >= 0 && index < size());
+	return programs[(size_t) index];
+}
+
+void ChromaProgramBank::setName(int index, const juce::String& newName)
+{
+	jassert (index >= 0 && index < size());
+	programs[(size_t) index].name = newName;
+}
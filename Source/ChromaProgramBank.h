@@ -0,0 +1,39 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChromaKeyMap.h"
+#include "ChromaPalette.h"
+
+// The processor's programs.
+// Everything a program switch needs is worked out when a program is added:
+// its key map is made up front and its palette's colour table is built, so
+// switching to it only copies the key map and swaps pointers.
+class ChromaProgramBank
+{
+public:
+	struct Program
+	{
+		juce::String name;
+		int base = 12;
+		ChromaKeyMap::Layout layout = ChromaKeyMap::guitar;
+		int keyMapBase = 52;
+		int rangeStart = 0, rangeEnd = 127;
+		int midiChannel = 1;
+		std::shared_ptr<ChromaPalette> palette;
+
+		ChromaKeyMap::KeyMap keyMap;	// filled in by add()
+	};
+
+	ChromaProgramBank() = default;
+
+	// a few layouts for common bases
+	static ChromaProgramBank createFactoryBank();
+
+	void add(Program program);
+	int size() const noexcept;
+	const Program& operator[](int index) const noexcept;
+	void setName(int index, const juce::String& newName);
+
+private:
+	std::vector<Program> programs;
+};
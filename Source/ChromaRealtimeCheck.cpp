@@ -0,0 +1,260 @@
+/*
+ * Real-time safety check for processBlock, run with
+ *   chromakbd_benchmark rtcheck [blocks]
+ *
+ * The allocators (malloc, calloc, realloc, free, posix_memalign,
+ * aligned_alloc and memalign) and the blocking waits (pthread_mutex_lock and
+ * _trylock, pthread_rwlock_rdlock and _wrlock, and sem_wait) are replaced
+ * for the whole benchmark binary. They behave as usual, except on a thread
+ * that has set inAudioCallback, where every call is reported with a stack
+ * trace.
+ * Link with -rdynamic to get function names in the traces, or feed the
+ * addresses to addr2line.
+ */
+
+#include <JuceHeader.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include "ChromaRealtimeCheck.h"
+#include "PluginProcessor.h"
+#include "ChromaKeyboard.h"
+
+extern "C"
+{
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void __libc_free(void* ptr);
+}
+
+namespace
+{
+	constexpr int maxReports = 16;	// stack traces printed, the rest are only counted
+
+	thread_local bool inAudioCallback = false;
+	std::atomic<int> numViolations { 0 };
+
+	// the functions the replacements below stand in for, looked up on first use
+	template <typename Fn>
+	Fn getReal(std::atomic<Fn>& real, const char* name)
+	{
+		auto fn = real.load();
+		if (fn == nullptr) {
+			fn = (Fn) dlsym(RTLD_NEXT, name);
+			real = fn;
+		}
+		return fn;
+	}
+
+	using MutexLockFn = int (*)(pthread_mutex_t*);
+	using RwlockFn = int (*)(pthread_rwlock_t*);
+	using SemWaitFn = int (*)(sem_t*);
+	using PosixMemalignFn = int (*)(void**, size_t, size_t);
+	using AlignedAllocFn = void* (*)(size_t, size_t);
+	std::atomic<MutexLockFn> realMutexLock { nullptr }, realMutexTrylock { nullptr };
+	std::atomic<RwlockFn> realRwlockRdlock { nullptr }, realRwlockWrlock { nullptr };
+	std::atomic<SemWaitFn> realSemWait { nullptr };
+	std::atomic<PosixMemalignFn> realPosixMemalign { nullptr };
+	std::atomic<AlignedAllocFn> realAlignedAlloc { nullptr }, realMemalign { nullptr };
+
+	void reportViolation(const char* what)
+	{
+		// reporting locks and allocates too, which mustn't count again
+		inAudioCallback = false;
+
+		if (numViolations++ < maxReports) {
+			char header[64];
+			auto length = std::snprintf(header, sizeof(header), "%s inside processBlock:\n", what);
+			::write(STDERR_FILENO, header, (size_t) juce::jlimit(0, (int) sizeof(header) - 1, length));
+
+			void* frames[64];
+			backtrace_symbols_fd(frames, backtrace(frames, 64), STDERR_FILENO);
+			::write(STDERR_FILENO, "\n", 1);
+		}
+
+		inAudioCallback = true;
+	}
+}
+
+extern "C"
+{
+	__attribute__((visibility("default"))) void* malloc(size_t size)
+	{
+		if (inAudioCallback)
+			reportViolation("malloc");
+		return __libc_malloc(size);
+	}
+
+	__attribute__((visibility("default"))) void* calloc(size_t count, size_t size)
+	{
+		if (inAudioCallback)
+			reportViolation("calloc");
+		return __libc_calloc(count, size);
+	}
+
+	__attribute__((visibility("default"))) void* realloc(void* ptr, size_t size)
+	{
+		if (inAudioCallback)
+			reportViolation("realloc");
+		return __libc_realloc(ptr, size);
+	}
+
+	__attribute__((visibility("default"))) void free(void* ptr)
+	{
+		if (inAudioCallback && ptr != nullptr)
+			reportViolation("free");
+		__libc_free(ptr);
+	}
+
+	// aligned new and some containers allocate through these instead
+	__attribute__((visibility("default"))) int posix_memalign(void** ptr, size_t alignment, size_t size)
+	{
+		if (inAudioCallback)
+			reportViolation("posix_memalign");
+		return getReal(realPosixMemalign, "posix_memalign")(ptr, alignment, size);
+	}
+
+	__attribute__((visibility("default"))) void* aligned_alloc(size_t alignment, size_t size)
+	{
+		if (inAudioCallback)
+			reportViolation("aligned_alloc");
+		return getReal(realAlignedAlloc, "aligned_alloc")(alignment, size);
+	}
+
+	__attribute__((visibility("default"))) void* memalign(size_t alignment, size_t size)
+	{
+		if (inAudioCallback)
+			reportViolation("memalign");
+		return getReal(realMemalign, "memalign")(alignment, size);
+	}
+
+	__attribute__((visibility("default"))) int pthread_mutex_lock(pthread_mutex_t* mutex)
+	{
+		if (inAudioCallback)
+			reportViolation("pthread_mutex_lock");
+		return getReal(realMutexLock, "pthread_mutex_lock")(mutex);
+	}
+
+	// never blocks, but a lock the audio thread shares can still keep it
+	// from its work, or spin on it
+	__attribute__((visibility("default"))) int pthread_mutex_trylock(pthread_mutex_t* mutex)
+	{
+		if (inAudioCallback)
+			reportViolation("pthread_mutex_trylock");
+		return getReal(realMutexTrylock, "pthread_mutex_trylock")(mutex);
+	}
+
+	__attribute__((visibility("default"))) int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+	{
+		if (inAudioCallback)
+			reportViolation("pthread_rwlock_rdlock");
+		return getReal(realRwlockRdlock, "pthread_rwlock_rdlock")(lock);
+	}
+
+	__attribute__((visibility("default"))) int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+	{
+		if (inAudioCallback)
+			reportViolation("pthread_rwlock_wrlock");
+		return getReal(realRwlockWrlock, "pthread_rwlock_wrlock")(lock);
+	}
+
+	__attribute__((visibility("default"))) int sem_wait(sem_t* semaphore)
+	{
+		if (inAudioCallback)
+			reportViolation("sem_wait");
+		return getReal(realSemWait, "sem_wait")(semaphore);
+	}
+}
+
+int runRealtimeCheck(int numBlocks)
+{
+	constexpr double sampleRate = 48000.0;
+	constexpr int blockSize = 256;
+
+	// the first backtrace() loads libgcc, which allocates
+	void* warmUp[1];
+	backtrace(warmUp, 1);
+
+	ChromakbdAudioProcessor processor;
+	processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+	processor.prepareToPlay(sampleRate, blockSize);
+
+	std::unique_ptr<juce::AudioProcessorEditor> editor(processor.createEditor());
+	ChromaKeyboard* keyboard = nullptr;
+	for (auto* child: editor->getChildren())
+		if (auto* k = dynamic_cast<ChromaKeyboard*>(child))
+			keyboard = k;
+	jassert (keyboard != nullptr);
+
+	std::atomic<bool> audioFinished { false };
+
+	std::thread audioThread([&] {
+		juce::AudioBuffer<float> buffer(processor.getTotalNumOutputChannels(), blockSize);
+		juce::MidiBuffer midi;
+		midi.ensureSize(1 << 16);	// as a host would, well before the callback
+		juce::Random random(1);
+
+		for (int jBlock = 0; jBlock < numBlocks; jBlock++) {
+			// a flood of host notes, all cut off every hundred blocks
+			midi.clear();
+			for (int jEvent = 0; jEvent < 64; jEvent++) {
+				auto channel = 1 + random.nextInt(16);
+				auto note = random.nextInt(128);
+				auto offset = random.nextInt(blockSize);
+				if (random.nextBool())
+					midi.addEvent(juce::MidiMessage::noteOn(channel, note, 1.0f), offset);
+				else
+					midi.addEvent(juce::MidiMessage::noteOff(channel, note), offset);
+			}
+			if (jBlock % 100 == 99)
+				for (int channel = 1; channel <= 16; channel++)
+					midi.addEvent(juce::MidiMessage::allNotesOff(channel), blockSize - 1);
+
+			inAudioCallback = true;
+			processor.processBlock(buffer, midi);
+			inAudioCallback = false;
+
+			// roughly real time, so the editor side overlaps every block
+			std::this_thread::sleep_for(std::chrono::microseconds((int) (1.0e6 * blockSize / sampleRate)));
+		}
+
+		audioFinished = true;
+	});
+
+	// the editor side: play notes the way the keyboard does, switch timing
+	// modes, and redraw whatever the audio thread says is pressed
+	juce::Random random(2);
+	for (int jFrame = 0; ! audioFinished; jFrame++) {
+		for (int jEvent = 0; jEvent < 8; jEvent++)
+			processor.uiNoteEvents.push({
+				1 + random.nextInt(16),
+				random.nextInt(128),
+				random.nextFloat(),
+				random.nextBool(),
+				juce::Time::getMillisecondCounterHiRes() });
+
+		if (jFrame % 50 == 0)
+			processor.setFixedLatencyTiming(! processor.hasFixedLatencyTiming());
+
+		if (keyboard != nullptr)
+			keyboard->timerCallback();
+		editor->createComponentSnapshot(editor->getLocalBounds());
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	audioThread.join();
+	editor.reset();
+	processor.releaseResources();
+
+	std::cout
+		<< "blocks: " << numBlocks
+		<< ", violations: " << numViolations.load()
+		<< ", editor notes dropped: " << processor.uiNoteEvents.getNumDropped()
+		<< ", midi overflows: " << processor.getNumMidiOverflows() << std::endl;
+
+	return numViolations.load();
+}
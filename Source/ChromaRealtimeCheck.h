@@ -0,0 +1,10 @@
+#pragma once
+
+// Runs the processor's audio callback on its own thread for numBlocks
+// blocks, with host note floods on the audio side and editor notes and
+// repaints on the message thread at the same time. Any allocation,
+// deallocation, lock or semaphore wait inside processBlock is reported on
+// stderr with a stack trace.
+// Returns the number of violations, so 0 means the callback is real-time safe.
+// Only works in the benchmark binary, which replaces malloc and friends.
+int runRealtimeCheck(int numBlocks);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Objects the message thread has replaced but the audio thread may still
+// be reading, through a pointer it loaded before the swap. Each is freed
+// once the audio thread has finished a block since it was retired, as it
+// can't have held on to the old pointer past that.
+template <typename T>
+class ChromaRetiredList
+{
+public:
+	ChromaRetiredList() = default;
+
+	// message thread, once nothing the audio thread loads points to it any more
+	void retire(std::unique_ptr<T> object)
+	{
+		if (object != nullptr)
+			retired.push_back({ std::move(object), numBlocks.load() });
+		freeFinished();
+	}
+
+	void freeFinished()
+	{
+		auto blocks = numBlocks.load();
+		retired.erase(
+			std::remove_if(retired.begin(), retired.end(), [blocks] (const Retired& r) { return r.blocksWhenRetired != blocks; }),
+			retired.end());
+	}
+
+	// audio thread, after each block
+	void blockDone() noexcept
+	{
+		numBlocks.fetch_add(1);
+	}
+
+private:
+	struct Retired
+	{
+		std::unique_ptr<T> object;
+		juce::uint32 blocksWhenRetired;
+	};
+	std::vector<Retired> retired;
+	std::atomic<juce::uint32> numBlocks { 0 };
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaRetiredList)
+};
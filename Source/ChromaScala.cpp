@@ -0,0 +1,345 @@
+#include "ChromaScala.h"
+
+namespace
+{
+	// the lines that aren't comments
+	juce::StringArray getContentLines(const juce::String& text)
+	{
+		juce::StringArray lines;
+		for (auto& line: juce::StringArray::fromLines(text))
+			if (! line.startsWithChar('!'))
+				lines.add(line.trim());
+		return lines;
+	}
+
+	// anything after the first space or tab is a comment
+	juce::String getFirstToken(const juce::String& line)
+	{
+		return line.initialSectionNotContaining(" \t");
+	}
+
+	bool parseInt(const juce::String& token, int& value)
+	{
+		if (token.isEmpty() || ! token.containsOnly("-0123456789"))
+			return false;
+		value = token.getIntValue();
+		return true;
+	}
+
+	int floorDiv(int a, int b)
+	{
+		return a >= 0 ? a / b : -((-a + b - 1) / b);
+	}
+}
+
+juce::String ChromaScala::parseScale(const juce::String& text, Scale& scale)
+{
+	auto lines = getContentLines(text);
+	if (lines.size() < 2)
+		return "not a Scala scale";
+
+	scale = {};
+	scale.description = lines[0];
+
+	int numNotes = 0;
+	if (! parseInt(getFirstToken(lines[1]), numNotes) || numNotes < 1)
+		return "no note count";
+	if (lines.size() < 2 + numNotes)
+		return "expected " + juce::String(numNotes) + " notes";
+
+	for (int jNote = 0; jNote < numNotes; jNote++) {
+		auto token = getFirstToken(lines[2 + jNote]);
+		double cents = 0;
+
+		if (token.containsChar('.')) {
+			if (! token.containsOnly("-+0123456789."))
+				return "can't read " + token;
+			cents = token.getDoubleValue();
+		}
+		else {
+			auto numerator = token.upToFirstOccurrenceOf("/", false, false);
+			auto denominator = token.containsChar('/') ? token.fromFirstOccurrenceOf("/", false, false) : juce::String("1");
+			if (numerator.isEmpty() || denominator.isEmpty()
+					|| ! numerator.containsOnly("0123456789") || ! denominator.containsOnly("0123456789"))
+				return "can't read " + token;
+
+			auto ratio = numerator.getDoubleValue() / denominator.getDoubleValue();
+			if (! (ratio > 0) || ! std::isfinite(ratio))
+				return "can't read " + token;
+			cents = 1200.0 * std::log2(ratio);
+		}
+
+		scale.cents.push_back(cents);
+	}
+
+	if (! (scale.cents.back() > 0))
+		return "the period must be above 1/1";
+	return {};
+}
+
+juce::String ChromaScala::parseKeyboardMapping(const juce::String& text, KeyboardMapping& mapping)
+{
+	auto lines = getContentLines(text);
+	if (lines.size() < 7)
+		return "not a Scala keyboard mapping";
+
+	mapping = {};
+	int* fields[] = { &mapping.mapSize, &mapping.firstNote, &mapping.lastNote, &mapping.middleNote, &mapping.referenceNote };
+	for (int jField = 0; jField < 5; jField++)
+		if (! parseInt(getFirstToken(lines[jField]), *fields[jField]))
+			return "can't read " + lines[jField];
+
+	mapping.referenceFrequency = getFirstToken(lines[5]).getDoubleValue();
+	if (! (mapping.referenceFrequency > 0))
+		return "can't read the reference frequency";
+
+	if (! parseInt(getFirstToken(lines[6]), mapping.periodDegree))
+		return "can't read the period degree";
+	if (mapping.periodDegree == 0)
+		mapping.periodDegree = -1;
+
+	if (mapping.mapSize < 0 || mapping.mapSize > 128)
+		return "a map size of " + juce::String(mapping.mapSize);
+
+	// keys past the end of the list are left out
+	mapping.degrees.assign((size_t) mapping.mapSize, -1);
+	for (int jKey = 0; jKey < mapping.mapSize && 7 + jKey < lines.size(); jKey++) {
+		auto token = getFirstToken(lines[7 + jKey]);
+		if (token.equalsIgnoreCase("x"))
+			continue;
+		if (! parseInt(token, mapping.degrees[(size_t) jKey]) || mapping.degrees[(size_t) jKey] < 0)
+			return "can't read " + token;
+	}
+	return {};
+}
+
+std::shared_ptr<const ChromaScala::Tuning> ChromaScala::makeTuning(const Scale& scale, const KeyboardMapping& mapping)
+{
+	jassert (! scale.cents.empty());
+
+	auto numDegrees = (int) scale.cents.size();
+	auto periodCents = scale.cents.back();
+
+	auto getDegreeCents = [&] (int degree) {
+		auto period = floorDiv(degree, numDegrees);
+		auto j = degree - period * numDegrees;
+		return period * periodCents + (j == 0 ? 0.0 : scale.cents[(size_t) j - 1]);
+	};
+
+	// without a mapping every key is the next degree, repeating at the period
+	auto mapSize = mapping.mapSize > 0 ? mapping.mapSize : numDegrees;
+	auto repeatCents = mapping.mapSize > 0 && mapping.periodDegree > 0
+		? getDegreeCents(mapping.periodDegree)
+		: periodCents;
+
+	// the degree a key plays, counting from the middle note, or false if it's left out
+	auto getKeyDegree = [&] (int key, int& degree, int& repeat) {
+		auto offset = key - mapping.middleNote;
+		repeat = floorDiv(offset, mapSize);
+		auto index = offset - repeat * mapSize;
+		degree = mapping.mapSize > 0 ? mapping.degrees[(size_t) index] : index;
+		return degree >= 0;
+	};
+
+	auto getKeyCents = [&] (int degree, int repeat) {
+		return repeat * repeatCents + getDegreeCents(degree);
+	};
+
+	int degree = 0, repeat = 0;
+	auto referenceCents = getKeyDegree(mapping.referenceNote, degree, repeat)
+		? getKeyCents(degree, repeat)
+		: 100.0 * (mapping.referenceNote - mapping.middleNote);
+	auto referenceSemitones = 69.0 + 12.0 * std::log2(mapping.referenceFrequency / 440.0);
+
+	auto tuning = std::make_shared<Tuning>();
+	tuning->name = scale.description;
+	tuning->numDegrees = numDegrees;
+
+	for (int key = 0; key < 128; key++) {
+		tuning->semitones[(size_t) key] = std::numeric_limits<double>::quiet_NaN();
+		tuning->periodPositions[(size_t) key] = 0;
+		tuning->degrees[(size_t) key] = -1;
+		tuning->periods[(size_t) key] = 0;
+
+		if (key < mapping.firstNote || key > mapping.lastNote || ! getKeyDegree(key, degree, repeat))
+			continue;
+
+		auto cents = getKeyCents(degree, repeat);
+		tuning->semitones[(size_t) key] = referenceSemitones + (cents - referenceCents) / 100.0;
+
+		auto degreeInPeriod = degree % numDegrees;
+		tuning->degrees[(size_t) key] = degreeInPeriod;
+		tuning->periods[(size_t) key] = repeat + degree / numDegrees;
+		tuning->periodPositions[(size_t) key] = (float) (getDegreeCents(degreeInPeriod) / periodCents);
+	}
+
+	return tuning;
+}
+
+bool ChromaScala::readIndexEntry(const juce::File& file, IndexEntry& entry)
+{
+	juce::MemoryMappedFile mapped(file, juce::MemoryMappedFile::readOnly);
+	auto* data = static_cast<const char*>(mapped.getData());
+	if (data == nullptr)
+		return false;
+
+	// just the description and the note count, which come first
+	auto* end = data + mapped.getSize();
+	juce::String lines[2];
+	int numLines = 0;
+	for (auto* line = data; line < end && numLines < 2;) {
+		auto* lineEnd = std::find(line, end, '\n');
+		if (*line != '!')
+			lines[numLines++] = juce::String::fromUTF8(line, (int) (lineEnd - line)).trim();
+		line = lineEnd + 1;
+	}
+
+	int numNotes = 0;
+	if (numLines < 2 || ! parseInt(getFirstToken(lines[1]), numNotes) || numNotes < 1)
+		return false;
+
+	entry = { file, lines[0].isEmpty() ? file.getFileNameWithoutExtension() : lines[0], numNotes };
+	return true;
+}
+
+juce::Array<ChromaScala::IndexEntry> ChromaScala::indexFolder(
+	const juce::File& folder,
+	const std::function<bool()>& shouldStop )
+{
+	juce::Array<IndexEntry> entries;
+	for (const auto& file: juce::RangedDirectoryIterator(folder, true, "*.scl")) {
+		if (shouldStop())
+			break;
+		IndexEntry entry;
+		if (readIndexEntry(file.getFile(), entry))
+			entries.add(entry);
+	}
+
+	std::sort(entries.begin(), entries.end(), [] (const IndexEntry& a, const IndexEntry& b) {
+		return a.file.getFileName().compareNatural(b.file.getFileName()) < 0;
+	});
+	return entries;
+}
+
+//==============================================================================
+ChromaScalaLoader::ChromaScalaLoader() :
+		juce::Thread("scala loader")
+{
+	startThread(juce::Thread::Priority::low);
+}
+
+ChromaScalaLoader::~ChromaScalaLoader()
+{
+	signalThreadShouldExit();
+	notify();
+	stopThread(4000);
+	cancelPendingUpdate();
+}
+
+void ChromaScalaLoader::load(const juce::File& scale, const juce::File& keyboardMapping)
+{
+	{
+		const juce::ScopedLock sl(lock);
+		scaleToLoad = scale;
+		mappingToLoad = keyboardMapping;
+		hasLoadRequest = true;
+	}
+	notify();
+}
+
+void ChromaScalaLoader::index(const juce::File& folder)
+{
+	{
+		const juce::ScopedLock sl(lock);
+		folderToIndex = folder;
+		hasIndexRequest = true;
+	}
+	notify();
+}
+
+void ChromaScalaLoader::run()
+{
+	while (! threadShouldExit()) {
+		juce::File scale, mapping, folder;
+		bool shouldLoad, shouldIndex;
+		{
+			const juce::ScopedLock sl(lock);
+			scale = scaleToLoad, mapping = mappingToLoad, folder = folderToIndex;
+			shouldLoad = hasLoadRequest, shouldIndex = hasIndexRequest;
+			hasLoadRequest = hasIndexRequest = false;
+		}
+
+		if (! shouldLoad && ! shouldIndex) {
+			wait(-1);
+			continue;
+		}
+
+		if (shouldLoad) {
+			juce::String error;
+			auto tuning = loadTuning(scale, mapping, error);
+			const juce::ScopedLock sl(lock);
+			loadedTuning = std::move(tuning);
+			loadError = error;
+			hasLoadResult = true;
+		}
+
+		if (shouldIndex) {
+			auto entries = ChromaScala::indexFolder(folder, [this] { return threadShouldExit(); });
+			const juce::ScopedLock sl(lock);
+			indexedFolder = folder;
+			folderIndex = std::move(entries);
+			hasIndexResult = true;
+		}
+
+		triggerAsyncUpdate();
+	}
+}
+
+void ChromaScalaLoader::handleAsyncUpdate()
+{
+	std::shared_ptr<const ChromaScala::Tuning> tuning;
+	juce::String error;
+	juce::File folder;
+	juce::Array<ChromaScala::IndexEntry> entries;
+	bool hasTuning, hasIndex;
+	{
+		const juce::ScopedLock sl(lock);
+		hasTuning = std::exchange(hasLoadResult, false);
+		hasIndex = std::exchange(hasIndexResult, false);
+		tuning = std::move(loadedTuning);
+		error = loadError;
+		folder = indexedFolder;
+		entries.swapWith(folderIndex);
+	}
+
+	if (hasTuning && onLoaded != nullptr)
+		onLoaded(tuning, error);
+	if (hasIndex && onIndexed != nullptr)
+		onIndexed(folder, entries);
+}
+
+std::shared_ptr<const ChromaScala::Tuning> ChromaScalaLoader::loadTuning(
+	const juce::File& scaleFile,
+	const juce::File& mappingFile,
+	juce::String& error )
+{
+	ChromaScala::Scale scale;
+	error = ChromaScala::parseScale(scaleFile.loadFileAsString(), scale);
+	if (error.isNotEmpty()) {
+		error = scaleFile.getFileName() + ": " + error;
+		return nullptr;
+	}
+	if (scale.description.isEmpty())
+		scale.description = scaleFile.getFileNameWithoutExtension();
+
+	ChromaScala::KeyboardMapping mapping;
+	if (mappingFile != juce::File()) {
+		error = ChromaScala::parseKeyboardMapping(mappingFile.loadFileAsString(), mapping);
+		if (error.isNotEmpty()) {
+			error = mappingFile.getFileName() + ": " + error;
+			return nullptr;
+		}
+	}
+
+	return ChromaScala::makeTuning(scale, mapping);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Scala tunings: scales (.scl) and keyboard mappings (.kbm), as described
+// at https://www.huygens-fokker.org/scala/scl_format.html
+namespace ChromaScala
+{
+	struct Scale
+	{
+		juce::String description;
+		std::vector<double> cents;	// degrees 1 to n; the last is the period
+	};
+
+	struct KeyboardMapping
+	{
+		int mapSize = 0;	// 0 maps every key to the next degree
+		int firstNote = 0, lastNote = 127;
+		int middleNote = 60;	// where degree 0 is
+		int referenceNote = 60;
+		double referenceFrequency = 261.6255653;
+		int periodDegree = -1;	// the degree the mapping repeats at, -1 for the scale's period
+		std::vector<int> degrees;	// mapSize of them, -1 for keys left out
+	};
+
+	// Built once, then only read, so it can be shared between threads.
+	struct Tuning
+	{
+		juce::String name;
+		int numDegrees = 0;
+		std::array<double, 128> semitones;	// above MIDI note 0, NaN for keys left out
+		std::array<float, 128> periodPositions;	// 0 to 1 through the period, for colours
+		std::array<int, 128> degrees;	// -1 for keys left out
+		std::array<int, 128> periods;	// repeats of the period above the middle note
+	};
+
+	// Each returns an error message, or nothing if it worked
+	juce::String parseScale(const juce::String& text, Scale& scale);
+	juce::String parseKeyboardMapping(const juce::String& text, KeyboardMapping& mapping);
+
+	std::shared_ptr<const Tuning> makeTuning(const Scale& scale, const KeyboardMapping& mapping);
+
+	// What a folder's browser shows for a scale, read without parsing it
+	struct IndexEntry
+	{
+		juce::File file;
+		juce::String description;
+		int numNotes = 0;
+	};
+
+	// Reads only the first lines of the file, through a memory map, so
+	// thousands of files index in the time it takes to open them.
+	bool readIndexEntry(const juce::File& file, IndexEntry& entry);
+	juce::Array<IndexEntry> indexFolder(const juce::File& folder, const std::function<bool()>& shouldStop);
+}
+
+// Reads Scala files and folders on its own thread, and hands the results
+// over on the message thread. Only the latest request of each kind is
+// kept; one arriving while another is running waits for it to finish.
+class ChromaScalaLoader : private juce::Thread, private juce::AsyncUpdater
+{
+public:
+	ChromaScalaLoader();
+	~ChromaScalaLoader() override;
+
+	// the mapping may be File(), for the standard one
+	void load(const juce::File& scale, const juce::File& keyboardMapping);
+	void index(const juce::File& folder);
+
+	std::function<void(std::shared_ptr<const ChromaScala::Tuning>, const juce::String& error)> onLoaded;
+	std::function<void(const juce::File& folder, const juce::Array<ChromaScala::IndexEntry>&)> onIndexed;
+
+private:
+	void run() override;
+	void handleAsyncUpdate() override;
+
+	static std::shared_ptr<const ChromaScala::Tuning> loadTuning(
+		const juce::File& scale,
+		const juce::File& keyboardMapping,
+		juce::String& error );
+
+	juce::CriticalSection lock;
+
+	// requests, from the message thread
+	juce::File scaleToLoad, mappingToLoad, folderToIndex;
+	bool hasLoadRequest = false, hasIndexRequest = false;
+
+	// results, for the message thread
+	std::shared_ptr<const ChromaScala::Tuning> loadedTuning;
+	juce::String loadError;
+	bool hasLoadResult = false;
+	juce::File indexedFolder;
+	juce::Array<ChromaScala::IndexEntry> folderIndex;
+	bool hasIndexResult = false;
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaScalaLoader)
+};
@@ -0,0 +1,145 @@
+#include "ChromaTuningPanel.h"
+
+ChromaTuningPanel::ChromaTuningPanel(ChromakbdAudioProcessor& p) :
+		processor(p)
+{
+	for (auto* button: { &folderButton, &mappingButton, &equalButton }) {
+		button->setWantsKeyboardFocus(false);
+		addAndMakeVisible(button);
+	}
+	folderButton.onClick = [this] { chooseFolder(); };
+	mappingButton.onClick = [this] { chooseMapping(); };
+	equalButton.onClick = [this] { processor.clearScalaTuning(); };
+
+	searchBox.setTextToShowWhenEmpty("search", juce::Colours::grey);
+	searchBox.onTextChange = [this] { updateFilter(); };
+	addAndMakeVisible(searchBox);
+
+	list.setRowHeight(20);
+	addAndMakeVisible(list);
+	addAndMakeVisible(status);
+
+	processor.tuningChanges.addChangeListener(this);
+	updateFilter();
+	updateStatus();
+
+	setSize(400, 360);
+}
+
+ChromaTuningPanel::~ChromaTuningPanel()
+{
+	processor.tuningChanges.removeChangeListener(this);
+}
+
+void ChromaTuningPanel::resized()
+{
+	auto area = getLocalBounds().reduced(4);
+
+	auto buttons = area.removeFromTop(24);
+	folderButton.setBounds(buttons.removeFromLeft(88));
+	buttons.removeFromLeft(4);
+	mappingButton.setBounds(buttons.removeFromLeft(88));
+	buttons.removeFromLeft(4);
+	equalButton.setBounds(buttons.removeFromLeft(64));
+
+	status.setBounds(area.removeFromBottom(24));
+	area.removeFromTop(4);
+	searchBox.setBounds(area.removeFromTop(24));
+	area.removeFromTop(4);
+	list.setBounds(area);
+}
+
+int ChromaTuningPanel::getNumRows()
+{
+	return shownEntries.size();
+}
+
+void ChromaTuningPanel::paintListBoxItem(int row, juce::Graphics& g, int width, int height, bool isSelected)
+{
+	auto& index = processor.getScalaIndex();
+	if (! juce::isPositiveAndBelow(row, shownEntries.size()))
+		return;
+	auto& entry = index.getReference(shownEntries[row]);
+
+	if (isSelected)
+		g.fillAll(findColour(juce::TextEditor::highlightColourId));
+
+	g.setColour(findColour(juce::ListBox::textColourId));
+	g.setFont((float) height * 0.7f);
+	g.drawText(juce::String(entry.numNotes), 4, 0, 32, height, juce::Justification::centredRight);
+	g.drawText(entry.description, 44, 0, width - 48, height, juce::Justification::centredLeft);
+}
+
+void ChromaTuningPanel::listBoxItemClicked(int row, const juce::MouseEvent&)
+{
+	if (! juce::isPositiveAndBelow(row, shownEntries.size()))
+		return;
+
+	auto& entry = processor.getScalaIndex().getReference(shownEntries[row]);
+	processor.loadScalaTuning(entry.file, processor.getScalaMappingFile());
+	status.setText("loading " + entry.file.getFileName() + "...", juce::dontSendNotification);
+}
+
+void ChromaTuningPanel::changeListenerCallback(juce::ChangeBroadcaster*)
+{
+	updateFilter();
+	updateStatus();
+}
+
+void ChromaTuningPanel::updateStatus()
+{
+	auto error = processor.getScalaError();
+	auto tuning = processor.getScalaTuning();
+
+	if (error.isNotEmpty())
+		status.setText(error, juce::dontSendNotification);
+	else if (tuning != nullptr)
+		status.setText(tuning->name + " (" + juce::String(tuning->numDegrees) + " notes)", juce::dontSendNotification);
+	else
+		status.setText(juce::String(processor.getBase()) + " equal divisions", juce::dontSendNotification);
+}
+
+void ChromaTuningPanel::updateFilter()
+{
+	auto& index = processor.getScalaIndex();
+	auto search = searchBox.getText().trim();
+
+	shownEntries.clearQuick();
+	for (int jEntry = 0; jEntry < index.size(); jEntry++) {
+		auto& entry = index.getReference(jEntry);
+		if (search.isEmpty()
+				|| entry.description.containsIgnoreCase(search)
+				|| entry.file.getFileName().containsIgnoreCase(search))
+			shownEntries.add(jEntry);
+	}
+
+	list.updateContent();
+	list.repaint();
+}
+
+void ChromaTuningPanel::chooseFolder()
+{
+	chooser = std::make_unique<juce::FileChooser>("Scala folder", processor.getScalaFolder());
+	chooser->launchAsync(
+		juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+		[this] (const juce::FileChooser& fc) {
+			auto folder = fc.getResult();
+			if (folder == juce::File())
+				return;
+			processor.indexScalaFolder(folder);
+			status.setText("indexing " + folder.getFileName() + "...", juce::dontSendNotification);
+		});
+}
+
+void ChromaTuningPanel::chooseMapping()
+{
+	chooser = std::make_unique<juce::FileChooser>("Scala keyboard mapping", processor.getScalaFolder(), "*.kbm");
+	chooser->launchAsync(
+		juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+		[this] (const juce::FileChooser& fc) {
+			auto mapping = fc.getResult();
+			if (mapping == juce::File() || processor.getScalaScaleFile() == juce::File())
+				return;
+			processor.loadScalaTuning(processor.getScalaScaleFile(), mapping);
+		});
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+// Picks a Scala tuning from an indexed folder of .scl files, with an
+// optional .kbm keyboard mapping, or goes back to equal divisions of base.
+// The folder is indexed and the files parsed on the processor's loader
+// thread, so the list stays responsive however many scales there are.
+class ChromaTuningPanel :
+	public juce::Component,
+	private juce::ListBoxModel,
+	private juce::ChangeListener
+{
+public:
+	explicit ChromaTuningPanel(ChromakbdAudioProcessor& processor);
+	~ChromaTuningPanel() override;
+
+	void resized() override;
+
+private:
+	int getNumRows() override;
+	void paintListBoxItem(int row, juce::Graphics& g, int width, int height, bool isSelected) override;
+	void listBoxItemClicked(int row, const juce::MouseEvent&) override;
+	void changeListenerCallback(juce::ChangeBroadcaster*) override;
+
+	void updateStatus();
+	void updateFilter();
+	void chooseFolder();
+	void chooseMapping();
+
+	ChromakbdAudioProcessor& processor;
+
+	juce::TextButton folderButton { "folder..." };
+	juce::TextButton mappingButton { "mapping..." };
+	juce::TextButton equalButton { "equal" };
+	juce::TextEditor searchBox;
+	juce::ListBox list { {}, this };
+	juce::Label status;
+
+	juce::Array<int> shownEntries;	// indices into the processor's scala index
+	std::unique_ptr<juce::FileChooser> chooser;
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaTuningPanel)
+};
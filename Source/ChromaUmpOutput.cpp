@@ -0,0 +1,79 @@
+#include "ChromaUmpOutput.h"
+
+ChromaUmpOutput::PitchTable ChromaUmpOutput::makeEdoTable(int base)
+{
+	jassert (base > 0);
+
+	PitchTable table;
+	for (int key = 0; key < (int) table.size(); key++) {
+		auto pitch = anchorNote + 12.0 * (key - anchorNote) / base;
+		auto fixed = (int) std::round(pitch * 512.0);
+		table[(size_t) key] = juce::isPositiveAndBelow(fixed, 128 * 512) ? fixed : -1;
+	}
+	return table;
+}
+
+ChromaUmpOutput::ChromaUmpOutput(int maxPackets) :
+		words((size_t) maxPackets * wordsPerPacket),
+		sampleOffsets((size_t) maxPackets)
+{
+	setBase(12);
+}
+
+void ChromaUmpOutput::setBase(int base)
+{
+	pitches = makeEdoTable(base);
+}
+
+bool ChromaUmpOutput::process(const NoteEventQueue::Event& e, int sampleOffset) noexcept
+{
+	if (! juce::isPositiveAndBelow(e.note, 128) || ! juce::isPositiveAndBelow(e.channel - 1, 16))
+		return true;
+	if ((size_t) numPackets >= sampleOffsets.size())
+		return false;
+
+	using Factory = juce::universal_midi_packets::Factory;
+	auto channel = (juce::uint8) (e.channel - 1);
+	auto note = (juce::uint8) e.note;
+	auto velocity = (juce::uint16) juce::roundToInt(juce::jlimit(0.0f, 1.0f, e.velocity) * 65535.0f);
+
+	juce::universal_midi_packets::PacketX2 packet;
+	if (e.isNoteOn) {
+		auto pitch = pitches[(size_t) e.note];
+		if (pitch < 0)
+			return true;	// out of range
+		packet = Factory::makeNoteOnV2(0, channel, note, pitchAttribute, velocity, (juce::uint16) pitch);
+	}
+	else {
+		packet = Factory::makeNoteOffV2(0, channel, note, 0, velocity, 0);
+	}
+
+	std::copy(packet.begin(), packet.end(), words.begin() + numPackets * wordsPerPacket);
+	sampleOffsets[(size_t) numPackets++] = sampleOffset;
+	return true;
+}
+
+void ChromaUmpOutput::translateToMidi1(juce::MidiBuffer& midi) const noexcept
+{
+	for (int jPacket = 0; jPacket < numPackets; jPacket++) {
+		auto offset = sampleOffsets[(size_t) jPacket];
+		juce::universal_midi_packets::View packet(words.data() + jPacket * wordsPerPacket);
+
+		juce::universal_midi_packets::Conversion::midi2ToMidi1DefaultTranslation(packet,
+			[&] (const juce::universal_midi_packets::View& midi1) {
+				// a MIDI 1.0 channel voice packet: status and two data bytes in the low 24 bits
+				auto word = midi1[0];
+				const juce::uint8 bytes[] = { (juce::uint8) (word >> 16), (juce::uint8) (word >> 8), (juce::uint8) word };
+				midi.addEvent(bytes, 3, offset);
+			});
+	}
+}
+
+void ChromaUmpOutput::clear() noexcept
+{
+	numPackets = 0;
+}
+
+const juce::uint32* ChromaUmpOutput::getWords() const noexcept { return words.data(); }
+int ChromaUmpOutput::getNumPackets() const noexcept { return numPackets; }
+int ChromaUmpOutput::getSampleOffset(int packet) const noexcept { return sampleOffsets[(size_t) packet]; }
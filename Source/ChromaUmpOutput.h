@@ -0,0 +1,47 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "NoteEventQueue.h"
+#include "ChromaMpeOutput.h"
+
+// Packs key events as MIDI 2.0 Universal MIDI Packets: note ons and offs
+// with 16-bit velocity, and each note on carrying the key's N-EDO pitch as
+// a Pitch 7.9 attribute, anchored like MPE output.
+// JUCE 7 gives plugins and MIDI devices MIDI 1.0 only, so there is nothing
+// yet to send these to; for now this is the benchmark's, to measure the
+// cost of a UMP path against the MIDI 1.0 one. Packets are written into a
+// buffer sized up front, so packing never allocates, and stay there until
+// clear().
+class ChromaUmpOutput
+{
+public:
+	static constexpr int wordsPerPacket = 2;	// MIDI 2.0 channel voice messages are 64 bits
+	static constexpr int anchorNote = ChromaMpeOutput::anchorNote;
+	static constexpr juce::uint8 pitchAttribute = 3;	// Pitch 7.9
+
+	// pitch 7.9 by key: 7 bits of note and 9 of fraction, -1 for keys out of range
+	using PitchTable = std::array<int, 128>;
+	static PitchTable makeEdoTable(int base);
+
+	explicit ChromaUmpOutput(int maxPackets);
+
+	void setBase(int base);
+
+	// adds the event's packet, or returns false if the buffer is full
+	bool process(const NoteEventQueue::Event& e, int sampleOffset) noexcept;
+	// adds every packet to midi as MIDI 1.0, with JUCE's default translation
+	void translateToMidi1(juce::MidiBuffer& midi) const noexcept;
+	void clear() noexcept;
+
+	const juce::uint32* getWords() const noexcept;
+	int getNumPackets() const noexcept;
+	int getSampleOffset(int packet) const noexcept;
+
+private:
+	PitchTable pitches;
+	std::vector<juce::uint32> words;
+	std::vector<int> sampleOffsets;	// by packet
+	int numPackets = 0;
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaUmpOutput)
+};
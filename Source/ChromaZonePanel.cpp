@@ -0,0 +1,106 @@
+#include "ChromaZonePanel.h"
+
+ChromaZonePanel::ChromaZonePanel(ChromakbdAudioProcessor& p) :
+		processor(p)
+{
+	const char* headingTexts[] = { "device", "layout", "key map base", "channel", "base" };
+	for (int jHeading = 0; jHeading < 5; jHeading++) {
+		headings[jHeading].setText(headingTexts[jHeading], juce::dontSendNotification);
+		addAndMakeVisible(headings[jHeading]);
+	}
+
+	keyboardDevices = EvdevKeyReader::findKeyboards();
+	auto* layoutParameter = dynamic_cast<juce::AudioParameterChoice*>(processor.parameters.getParameter("layout"));
+	jassert (layoutParameter != nullptr);
+
+	for (int jRow = 0; jRow < (int) rows.size(); jRow++) {
+		auto& row = rows[(size_t) jRow];
+		auto readerIndex = jRow + 1;
+		auto& reader = processor.getKeyReader(readerIndex);
+		auto zone = reader.getZone();
+
+		row.device.addItem("none", 1);
+		for (int jDevice = 0; jDevice < keyboardDevices.size(); jDevice++)
+			row.device.addItem(keyboardDevices[jDevice].getFileName(), jDevice + 2);
+		auto deviceIndex = processor.isKeyReaderOpen(readerIndex)
+			? keyboardDevices.indexOf(processor.getKeyReaderDevice(readerIndex))
+			: -1;
+		row.device.setSelectedId(deviceIndex + 2, juce::dontSendNotification);
+		row.device.onChange = [this, readerIndex] { deviceChanged(readerIndex); };
+
+		// ComboBox ids start at 1, like ChromaKeyMap::Layout
+		row.layout.addItemList(layoutParameter->choices, 1);
+		row.layout.setSelectedId((int) zone.layout, juce::dontSendNotification);
+		row.layout.onChange = [this, readerIndex] { zoneChanged(readerIndex); };
+
+		row.keyMapBase.setRange(0, 127, 1);
+		row.keyMapBase.setValue(zone.keyMapBase, juce::dontSendNotification);
+		row.midiChannel.setRange(1, 16, 1);
+		row.midiChannel.setValue(zone.midiChannel, juce::dontSendNotification);
+		row.base.setRange(1, 99, 1);
+		row.base.setValue(zone.base, juce::dontSendNotification);
+
+		for (auto* slider: { &row.keyMapBase, &row.midiChannel, &row.base })
+			slider->onValueChange = [this, readerIndex] { zoneChanged(readerIndex); };
+
+		for (auto* c: std::initializer_list<juce::Component*> {
+				&row.device, &row.layout, &row.keyMapBase, &row.midiChannel, &row.base }) {
+			c->setWantsKeyboardFocus(false);
+			addAndMakeVisible(c);
+		}
+	}
+
+	setSize(680, rowHeight * (1 + (int) rows.size()));
+}
+
+void ChromaZonePanel::resized()
+{
+	const int widths[] = { 240, 120, 112, 96, 96 };
+
+	for (int jRow = -1; jRow < (int) rows.size(); jRow++) {
+		auto area = getLocalBounds().removeFromTop(rowHeight).withY(rowHeight * (jRow + 1)).reduced(2);
+		juce::Component* cells[5];
+		if (jRow < 0) {
+			for (int jHeading = 0; jHeading < 5; jHeading++)
+				cells[jHeading] = &headings[jHeading];
+		} else {
+			auto& row = rows[(size_t) jRow];
+			cells[0] = &row.device;
+			cells[1] = &row.layout;
+			cells[2] = &row.keyMapBase;
+			cells[3] = &row.midiChannel;
+			cells[4] = &row.base;
+		}
+		for (int jCell = 0; jCell < 5; jCell++)
+			cells[jCell]->setBounds(area.removeFromLeft(widths[jCell]).reduced(2, 0));
+	}
+}
+
+void ChromaZonePanel::deviceChanged(int readerIndex)
+{
+	auto& row = rows[(size_t) readerIndex - 1];
+	auto index = row.device.getSelectedId() - 2;
+	if (! juce::isPositiveAndBelow(index, keyboardDevices.size())) {
+		processor.closeKeyReader(readerIndex);
+		return;
+	}
+
+	zoneChanged(readerIndex);
+	auto error = processor.openKeyReader(readerIndex, keyboardDevices[index]);
+	if (error.isNotEmpty()) {
+		row.device.setSelectedId(1, juce::dontSendNotification);
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Can't read keyboard", error);
+	}
+}
+
+void ChromaZonePanel::zoneChanged(int readerIndex)
+{
+	auto& row = rows[(size_t) readerIndex - 1];
+
+	EvdevKeyReader::Zone zone;
+	zone.layout = (ChromaKeyMap::Layout) juce::jmax(1, row.layout.getSelectedId());
+	zone.keyMapBase = (int) row.keyMapBase.getValue();
+	zone.midiChannel = (int) row.midiChannel.getValue();
+	zone.base = (int) row.base.getValue();
+	processor.getKeyReader(readerIndex).setZone(zone);
+}
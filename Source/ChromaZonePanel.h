@@ -0,0 +1,39 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+// Binds extra input devices to the processor's key readers, one row each,
+// with the zone each one plays: its layout, key map base, MIDI channel and
+// base. Reader 0 is left to the editor's "keys" menu, where it follows the
+// parameters. Everything is kept in the processor, so the panel can come
+// and go.
+class ChromaZonePanel : public juce::Component
+{
+public:
+	explicit ChromaZonePanel(ChromakbdAudioProcessor& processor);
+
+	void resized() override;
+
+	static constexpr int rowHeight = 28;
+
+private:
+	struct Row
+	{
+		juce::ComboBox device;
+		juce::ComboBox layout;
+		juce::Slider keyMapBase { juce::Slider::IncDecButtons, juce::Slider::TextBoxLeft };
+		juce::Slider midiChannel { juce::Slider::IncDecButtons, juce::Slider::TextBoxLeft };
+		juce::Slider base { juce::Slider::IncDecButtons, juce::Slider::TextBoxLeft };
+	};
+
+	void deviceChanged(int readerIndex);
+	void zoneChanged(int readerIndex);
+
+	ChromakbdAudioProcessor& processor;
+	juce::Array<juce::File> keyboardDevices;
+	std::array<Row, ChromakbdAudioProcessor::maxKeyReaders - 1> rows;	// readers 1 and up
+	juce::Label headings[5];
+
+	JUCE_DECLARE_NON_COPYABLE(ChromaZonePanel)
+};
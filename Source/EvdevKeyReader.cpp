@@ -0,0 +1,321 @@
+#include "EvdevKeyReader.h"
+#include "PluginProcessor.h"
+
+#if JUCE_LINUX
+ #include <fcntl.h>
+ #include <linux/input.h>
+ #include <poll.h>
+ #include <sys/ioctl.h>
+ #include <sys/stat.h>
+ #include <unistd.h>
+#endif
+
+EvdevKeyReader::EvdevKeyReader(const ChromakbdAudioProcessor& p, NoteEventQueue& q) :
+		juce::Thread("evdev key reader"),
+		processor(p),
+		destination(q)
+{ }
+
+EvdevKeyReader::~EvdevKeyReader()
+{
+	close();
+}
+
+juce::String EvdevKeyReader::open(const juce::File& newDevice, bool grabDevice)
+{
+	close();
+	device = newDevice;
+
+   #if JUCE_LINUX
+	fd = ::open(device.getFullPathName().toRawUTF8(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0)
+		return "can't open " + device.getFullPathName() + ": " + juce::String(strerror(errno));
+
+	struct stat info;
+	isRecording = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+
+	if (! isRecording) {
+		// timestamps on the same clock as Time::getMillisecondCounterHiRes()
+		int clock = CLOCK_MONOTONIC;
+		::ioctl(fd, EVIOCSCLOCKID, &clock);
+
+		if (grabDevice && ::ioctl(fd, EVIOCGRAB, 1) != 0) {
+			auto error = "can't grab " + device.getFullPathName() + ": " + juce::String(strerror(errno));
+			::close(fd);
+			fd = -1;
+			return error;
+		}
+	}
+
+	for (auto& key: heldKeys)
+		key = {};
+	for (auto& counts: notePressCounts)
+		counts.fill(0);
+	scancodeOffsetsLayout = 0;
+
+	startThread(juce::Thread::Priority::highest);
+	return {};
+   #else
+	juce::ignoreUnused(device, grabDevice);
+	return "input devices can only be read on Linux";
+   #endif
+}
+
+void EvdevKeyReader::close()
+{
+	stopThread(1000);
+
+   #if JUCE_LINUX
+	if (fd >= 0) {
+		::close(fd);	// also ungrabs it
+		fd = -1;
+	}
+   #endif
+}
+
+bool EvdevKeyReader::isReading() const
+{
+	return isThreadRunning();
+}
+
+juce::File EvdevKeyReader::getDevice() const
+{
+	return device;
+}
+
+void EvdevKeyReader::setZone(const Zone& zone)
+{
+	auto keyMapBase = juce::jlimit(0, 127, zone.keyMapBase);
+	writeZone(true, zone, ! usesZone.load() || keyMapBase != zoneKeyMapBase.load());
+}
+
+void EvdevKeyReader::followParameters()
+{
+	writeZone(false, getZone(), false);
+}
+
+void EvdevKeyReader::writeZone(bool isOn, const Zone& zone, bool movesKeyMapBase)
+{
+	auto s = zoneSequence.load(std::memory_order_relaxed);
+	zoneSequence.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	usesZone.store(isOn, std::memory_order_relaxed);
+	zoneLayout.store((int) zone.layout, std::memory_order_relaxed);
+	zoneMidiChannel.store(juce::jlimit(1, 16, zone.midiChannel), std::memory_order_relaxed);
+	zoneBase.store(juce::jmax(1, zone.base), std::memory_order_relaxed);
+	if (movesKeyMapBase) {
+		zoneKeyMapBase.store(juce::jlimit(0, 127, zone.keyMapBase), std::memory_order_relaxed);
+		zoneKeyMapBaseMoves.store(zoneKeyMapBaseMoves.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	zoneSequence.store(s + 2, std::memory_order_release);
+}
+
+bool EvdevKeyReader::hasZone() const noexcept
+{
+	return usesZone.load();
+}
+
+EvdevKeyReader::Zone EvdevKeyReader::getZone() const noexcept
+{
+	// until the reader thread has made the last move asked for, that's
+	// where the keys will be
+	auto isMoved = appliedKeyMapBaseMoves.load(std::memory_order_acquire) == zoneKeyMapBaseMoves.load();
+	return {
+		(ChromaKeyMap::Layout) zoneLayout.load(),
+		isMoved ? currentKeyMapBase.load() : zoneKeyMapBase.load(),
+		zoneMidiChannel.load(),
+		zoneBase.load() };
+}
+
+void EvdevKeyReader::updateZone()
+{
+	if (zoneSequence.load(std::memory_order_acquire) == readerZoneSequence)
+		return;
+
+	juce::uint32 sequence, keyMapBaseMoves;
+	int keyMapBase;
+	for (;;) {
+		sequence = zoneSequence.load(std::memory_order_acquire);
+		if (sequence & 1)
+			continue;
+
+		readerUsesZone = usesZone.load(std::memory_order_relaxed);
+		readerZone.layout = (ChromaKeyMap::Layout) zoneLayout.load(std::memory_order_relaxed);
+		readerZone.midiChannel = zoneMidiChannel.load(std::memory_order_relaxed);
+		readerZone.base = zoneBase.load(std::memory_order_relaxed);
+		keyMapBase = zoneKeyMapBase.load(std::memory_order_relaxed);
+		keyMapBaseMoves = zoneKeyMapBaseMoves.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (zoneSequence.load(std::memory_order_relaxed) == sequence)
+			break;
+	}
+	readerZoneSequence = sequence;
+
+	if (keyMapBaseMoves != appliedKeyMapBaseMoves.load(std::memory_order_relaxed)) {
+		readerZone.keyMapBase = keyMapBase;
+		currentKeyMapBase.store(keyMapBase, std::memory_order_relaxed);
+		appliedKeyMapBaseMoves.store(keyMapBaseMoves, std::memory_order_release);
+	}
+}
+
+juce::Array<juce::File> EvdevKeyReader::findKeyboards()
+{
+	juce::Array<juce::File> keyboards;
+   #if JUCE_LINUX
+	// by-id names are the friendliest, but not every device has one
+	juce::Array<juce::File> devices;
+	for (auto folder: { "/dev/input/by-id", "/dev/input/by-path" }) {
+		for (const auto& entry: juce::RangedDirectoryIterator(juce::File(folder), false, "*-event-kbd")) {
+			auto device = entry.getFile().getLinkedTarget();
+			if (! devices.contains(device)) {
+				devices.add(device);
+				keyboards.add(entry.getFile());
+			}
+		}
+	}
+   #endif
+	return keyboards;
+}
+
+int EvdevKeyReader::scancodeToKeycode(int scancode)
+{
+   #if JUCE_LINUX
+	// the physical keys under ChromaKeyMap::kbdString, in the same order
+	static constexpr int scancodes[40] = {
+		KEY_Z, KEY_X, KEY_C, KEY_V, KEY_B, KEY_N, KEY_M, KEY_COMMA, KEY_DOT, KEY_SLASH,
+		KEY_A, KEY_S, KEY_D, KEY_F, KEY_G, KEY_H, KEY_J, KEY_K, KEY_L, KEY_SEMICOLON,
+		KEY_Q, KEY_W, KEY_E, KEY_R, KEY_T, KEY_Y, KEY_U, KEY_I, KEY_O, KEY_P,
+		KEY_1, KEY_2, KEY_3, KEY_4, KEY_5, KEY_6, KEY_7, KEY_8, KEY_9, KEY_0,
+	};
+
+	// scancodes are small, so this is a lookup after the first call
+	static const auto keycodes = [] {
+		std::array<char, 256> table {};
+		for (int j = 0; j < 40; j++)
+			table[(size_t) scancodes[j]] = ChromaKeyMap::kbdString[j];
+		return table;
+	}();
+
+	return juce::isPositiveAndBelow(scancode, (int) keycodes.size()) ? keycodes[(size_t) scancode] : 0;
+   #else
+	juce::ignoreUnused(scancode);
+	return 0;
+   #endif
+}
+
+void EvdevKeyReader::run()
+{
+   #if JUCE_LINUX
+	input_event events[64];
+
+	while (! threadShouldExit()) {
+		// wake up now and then to see if we should stop
+		pollfd p { fd, POLLIN, 0 };
+		if (::poll(&p, 1, 100) <= 0)
+			continue;
+
+		auto bytesRead = ::read(fd, events, sizeof(events));
+		if (bytesRead < 0 && (errno == EAGAIN || errno == EINTR))
+			continue;
+		if (bytesRead <= 0)
+			break;	// unplugged, or the end of a recording
+
+		for (size_t j = 0; j < (size_t) bytesRead / sizeof(input_event); j++) {
+			auto& e = events[j];
+			if (e.type != EV_KEY || e.value == 2)	// 2 is an auto-repeat
+				continue;
+
+			// a recording's timestamps are from when it was made
+			auto timestamp = isRecording
+				? juce::Time::getMillisecondCounterHiRes()
+				: e.input_event_sec * 1000.0 + e.input_event_usec / 1000.0;
+			handleKey(e.code, e.value != 0, timestamp);
+		}
+	}
+
+	releaseAllKeys();
+   #endif
+}
+
+void EvdevKeyReader::handleKey(int scancode, bool isDown, double timestamp)
+{
+	if (! juce::isPositiveAndBelow(scancode, (int) heldKeys.size()))
+		return;
+
+	auto& held = heldKeys[(size_t) scancode];
+
+	if (! isDown) {
+		// release the note it started, even if the settings have changed since
+		if (held.note >= 0) {
+			auto& count = notePressCounts[(size_t) held.channel - 1][(size_t) held.note];
+			count = (juce::uint8) juce::jmax(0, count - 1);
+			if (count == 0)
+				destination.push({ held.channel, held.note, processor.getVelocity(), false, timestamp });
+		}
+		held = {};
+		return;
+	}
+
+	if (held.note >= 0)
+		return;	// already down
+
+	updateZone();
+	auto zone = readerUsesZone;
+
+   #if JUCE_LINUX
+	if (zone) {
+		auto shift = 0;
+		switch (scancode) {
+			case KEY_UP:       shift = 1; break;
+			case KEY_DOWN:     shift = -1; break;
+			case KEY_PAGEUP:   shift = readerZone.base; break;
+			case KEY_PAGEDOWN: shift = -readerZone.base; break;
+			default: break;
+		}
+		if (shift != 0) {
+			readerZone.keyMapBase = juce::jlimit(0, 127, readerZone.keyMapBase + shift);
+			currentKeyMapBase.store(readerZone.keyMapBase, std::memory_order_relaxed);
+			return;
+		}
+	}
+   #endif
+
+	auto layout = zone ? (int) readerZone.layout : processor.getLayout();
+	if (layout != scancodeOffsetsLayout)
+		updateScancodeOffsets(layout);
+
+	auto offset = scancodeOffsets[(size_t) scancode];
+	if (offset == ChromaKeyMap::unmapped)
+		return;
+
+	auto note = (zone ? readerZone.keyMapBase : processor.getKeyMapBase()) + offset;
+	auto rangeStart = zone ? 0 : processor.getRangeStart();
+	auto rangeEnd = zone ? 127 : processor.getRangeEnd();
+	if (note < rangeStart || note > rangeEnd)
+		return;
+
+	held = { note, juce::jlimit(1, 16, zone ? readerZone.midiChannel : processor.getMidiChannel()) };
+	auto& count = notePressCounts[(size_t) held.channel - 1][(size_t) note];
+	count = (juce::uint8) juce::jmin(255, count + 1);
+	destination.push({ held.channel, note, processor.getVelocity(), true, timestamp });
+}
+
+void EvdevKeyReader::updateScancodeOffsets(int layout)
+{
+	auto keyMap = ChromaKeyMap::makeKeyMap((ChromaKeyMap::Layout) layout);
+	for (int scancode = 0; scancode < (int) scancodeOffsets.size(); scancode++) {
+		auto keycode = scancodeToKeycode(scancode);
+		scancodeOffsets[(size_t) scancode] = keycode != 0 ? keyMap[(size_t) keycode] : ChromaKeyMap::unmapped;
+	}
+	scancodeOffsetsLayout = layout;
+}
+
+void EvdevKeyReader::releaseAllKeys()
+{
+	auto now = juce::Time::getMillisecondCounterHiRes();
+	for (int scancode = 0; scancode < (int) heldKeys.size(); scancode++)
+		handleKey(scancode, false, now);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChromaKeyMap.h"
+#include "NoteEventQueue.h"
+
+class ChromakbdAudioProcessor;
+
+// Reads key presses straight from a Linux input device (/dev/input/event*)
+// on its own thread, and plays them into a queue for the processor.
+// Keys are found by where they are on the keyboard, whatever the system's
+// keyboard layout, and work without the editor having focus. They're mapped
+// with the processor's layout, key map base, range, channel and velocity,
+// unless the reader is given a zone of its own.
+// Files of recorded input_events can be read too, for testing without
+// the hardware.
+class EvdevKeyReader : private juce::Thread
+{
+public:
+	// destination must have no other thread pushing to it
+	EvdevKeyReader(const ChromakbdAudioProcessor& processor, NoteEventQueue& destination);
+	~EvdevKeyReader() override;
+
+	// Starts reading, returning an error message if the device can't be
+	// opened. Grabbing the device stops its keys also reaching other
+	// applications, including our own editor.
+	juce::String open(const juce::File& device, bool grabDevice);
+	void close();
+
+	// false once closed, unplugged or at the end of a recording
+	bool isReading() const;
+	// the device last opened, even if it has stopped since
+	juce::File getDevice() const;
+
+	// A zone plays this reader's keys with settings of its own rather than
+	// the processor's, so several keyboards can share one instrument. Up and
+	// down move the zone by a step, page up and down by base steps, as they
+	// do on the editor. Velocity still comes from the processor, and the
+	// range is the whole MIDI range. The zone's base is only that page step:
+	// notes are tuned by the processor's base, like every other key's.
+	struct Zone
+	{
+		ChromaKeyMap::Layout layout = ChromaKeyMap::guitar;
+		int keyMapBase = 52;
+		int midiChannel = 1;
+		int base = 12;	// the page up and down step
+	};
+	// Setting a zone moves its key map base only if it differs from the one
+	// last set, so changing its other settings keeps where the keys moved it.
+	void setZone(const Zone& zone);
+	void followParameters();	// drops the zone
+	bool hasZone() const noexcept;
+	Zone getZone() const noexcept;
+
+	// devices that say they're keyboards
+	static juce::Array<juce::File> findKeyboards();
+
+	// the ChromaKeyboard keycode for the key at a scancode's position, or 0
+	static int scancodeToKeycode(int scancode);
+
+private:
+	void run() override;
+	void handleKey(int scancode, bool isDown, double timestamp);
+	void releaseAllKeys();
+	void updateScancodeOffsets(int layout);
+	void updateZone();
+	void writeZone(bool isOn, const Zone& zone, bool movesKeyMapBase);
+
+	const ChromakbdAudioProcessor& processor;
+	NoteEventQueue& destination;
+	juce::File device;
+	int fd = -1;
+	bool isRecording = false;
+
+	// The zone as last set on the message thread. The reader thread copies
+	// it whole before a key, retrying if it overlaps a write, and from then
+	// on only the reader thread moves the key map base: the message thread
+	// just asks for a new one, by counting zoneKeyMapBaseMoves up.
+	std::atomic<juce::uint32> zoneSequence { 0 };	// odd while a write is in progress
+	std::atomic<bool> usesZone { false };
+	std::atomic<int> zoneLayout { ChromaKeyMap::guitar };
+	std::atomic<int> zoneKeyMapBase { 52 };	// the one last asked for
+	std::atomic<int> zoneMidiChannel { 1 };
+	std::atomic<int> zoneBase { 12 };
+	std::atomic<juce::uint32> zoneKeyMapBaseMoves { 0 };
+
+	// where the reader thread has moved the key map base, for getZone(), and
+	// the last move it was asked for that it has made
+	std::atomic<int> currentKeyMapBase { 52 };
+	std::atomic<juce::uint32> appliedKeyMapBaseMoves { 0 };
+
+	// only used on the reader thread
+	bool readerUsesZone = false;
+	Zone readerZone;
+	juce::uint32 readerZoneSequence = 0;
+
+	struct HeldKey
+	{
+		int note = -1;	// -1 if the key isn't playing anything
+		int channel = 1;
+	};
+	std::array<HeldKey, 256> heldKeys;	// by scancode
+	std::array<std::array<juce::uint8, 128>, 16> notePressCounts {};	// by channel and note
+
+	// Key map offsets by scancode for the current layout, so a key press is
+	// one lookup into a table small enough to stay in cache. Each reader has
+	// its own, so more devices don't cost any more per key.
+	std::array<int, 256> scancodeOffsets;
+	int scancodeOffsetsLayout = 0;
+
+	JUCE_DECLARE_NON_COPYABLE(EvdevKeyReader)
+};
@@ -0,0 +1,123 @@
+#include "JackMidiOutput.h"
+#include "PluginProcessor.h"
+
+#if JUCE_LINUX
+ #include <jack/jack.h>
+ #include <jack/midiport.h>
+#endif
+
+JackMidiOutput::JackMidiOutput(ChromakbdAudioProcessor& p) :
+		processor(p)
+{
+	// the JACK path only carries the processor's own notes and tuning, so a
+	// block never needs more than this, whatever JACK's buffer size
+	midiByteBudget = ChromakbdAudioProcessor::maxNoteEventsPerBlock * ChromakbdAudioProcessor::bytesPerMidiEvent
+		+ ChromakbdAudioProcessor::maxTuningMessageBytes;
+	midi.ensureSize((size_t) midiByteBudget);
+}
+
+JackMidiOutput::~JackMidiOutput()
+{
+	close();
+}
+
+juce::String JackMidiOutput::open(const juce::String& clientName)
+{
+	close();
+
+   #if JUCE_LINUX
+	jack_status_t status;
+	client = jack_client_open(clientName.toRawUTF8(), JackNoStartServer, &status);
+	if (client == nullptr)
+		return "can't connect to the JACK server";
+
+	port = jack_port_register(client, "midi_out", JACK_DEFAULT_MIDI_TYPE, JackPortIsOutput, 0);
+	if (port == nullptr) {
+		jack_client_close(client);
+		client = nullptr;
+		return "can't make a JACK MIDI port";
+	}
+
+	jack_set_process_callback(client, processCallback, this);
+	jack_on_shutdown(client, shutdownCallback, this);
+
+	// take over from processBlock before JACK's first cycle
+	active = true;
+	if (jack_activate(client) != 0) {
+		active = false;
+		jack_client_close(client);
+		client = nullptr;
+		port = nullptr;
+		return "can't start the JACK client";
+	}
+	return {};
+   #else
+	juce::ignoreUnused(clientName);
+	return "JACK output is only available on Linux";
+   #endif
+}
+
+void JackMidiOutput::close()
+{
+   #if JUCE_LINUX
+	if (client != nullptr) {
+		jack_deactivate(client);	// waits for the process callback to finish
+		jack_client_close(client);
+		client = nullptr;
+		port = nullptr;
+	}
+   #endif
+	active = false;
+}
+
+bool JackMidiOutput::isOpen() const noexcept
+{
+	return active.load();
+}
+
+juce::String JackMidiOutput::getPortName() const
+{
+   #if JUCE_LINUX
+	if (port != nullptr)
+		return jack_port_name(port);
+   #endif
+	return {};
+}
+
+int JackMidiOutput::processCallback(juce::uint32 numFrames, void* self)
+{
+	return static_cast<JackMidiOutput*>(self)->process(numFrames);
+}
+
+void JackMidiOutput::shutdownCallback(void* self)
+{
+	// the server has gone, so hand the notes back to processBlock
+	static_cast<JackMidiOutput*>(self)->active = false;
+}
+
+int JackMidiOutput::process(juce::uint32 numFrames)
+{
+   #if JUCE_LINUX
+	auto* portBuffer = jack_port_get_buffer(port, numFrames);
+	jack_midi_clear_buffer(portBuffer);
+
+	// JACK's clock and Time::getMillisecondCounterHiRes() are both
+	// CLOCK_MONOTONIC on Linux, so the capture timestamps line up with frames
+	auto cycleStartTime = (double) jack_frames_to_time(client, jack_last_frame_time(client)) / 1000.0;
+
+	midi.clear();
+	processor.renderNoteEvents(
+		midi,
+		(int) numFrames,
+		(double) jack_get_sample_rate(client),
+		(int) numFrames,
+		cycleStartTime,
+		midiByteBudget );
+
+	for (const auto metadata: midi)
+		jack_midi_event_write(portBuffer, (jack_nframes_t) metadata.samplePosition, metadata.data, (size_t) metadata.numBytes);
+   #else
+	juce::ignoreUnused(numFrames);
+   #endif
+	return 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+class ChromakbdAudioProcessor;
+
+typedef struct _jack_client jack_client_t;
+typedef struct _jack_port jack_port_t;
+
+// Sends the processor's notes straight to a JACK MIDI port from JACK's own
+// process callback, rather than through the Standalone app's audio device.
+// While it's open it renders the notes instead of processBlock, each one
+// placed at the frame it was played, as far as the steady timing setting
+// allows. Needs a running JACK server; it never starts one.
+class JackMidiOutput
+{
+public:
+	explicit JackMidiOutput(ChromakbdAudioProcessor& processor);
+	~JackMidiOutput();
+
+	// returns an error message if there's no JACK server, or the port can't be made
+	juce::String open(const juce::String& clientName);
+	void close();
+	bool isOpen() const noexcept;
+
+	// "client:port", for jack_connect()
+	juce::String getPortName() const;
+
+private:
+	static int processCallback(juce::uint32 numFrames, void* self);
+	static void shutdownCallback(void* self);
+	int process(juce::uint32 numFrames);
+
+	ChromakbdAudioProcessor& processor;
+	jack_client_t* client = nullptr;
+	jack_port_t* port = nullptr;
+	std::atomic<bool> active { false };
+
+	// only touched by JACK's process thread once the client is active
+	juce::MidiBuffer midi;
+	int midiByteBudget = 0;
+
+	JUCE_DECLARE_NON_COPYABLE(JackMidiOutput)
+};
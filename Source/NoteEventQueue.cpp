@@ -0,0 +1,43 @@
+#include "NoteEventQueue.h"
+
+juce::MidiMessage NoteEventQueue::Event::toMidiMessage() const
+{
+	if (isNoteOn)
+		return juce::MidiMessage::noteOn(channel, note, velocity);
+	return juce::MidiMessage::noteOff(channel, note, velocity);
+}
+
+NoteEventQueue::NoteEventQueue(int capacity) :
+		fifo(capacity),
+		events((size_t) capacity)
+{ }
+
+bool NoteEventQueue::push(const Event& e) noexcept
+{
+	if (fifo.getFreeSpace() < 1) {
+		numDropped++;
+		return false;
+	}
+
+	fifo.write(1).forEach([&] (int index) {
+		events[(size_t) index] = e;
+	});
+	return true;
+}
+
+const NoteEventQueue::Event* NoteEventQueue::peek() const noexcept
+{
+	int start1, size1, start2, size2;
+	fifo.prepareToRead(1, start1, size1, start2, size2);
+	return size1 > 0 ? &events[(size_t) start1] : nullptr;
+}
+
+void NoteEventQueue::pop() noexcept
+{
+	fifo.finishedRead(1);
+}
+
+int NoteEventQueue::getNumDropped() const noexcept
+{
+	return numDropped.load();
+}
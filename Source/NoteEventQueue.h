@@ -0,0 +1,49 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Note events from the message thread to the audio thread.
+// There must be only one thread pushing and one thread popping. All the
+// storage is allocated up front, and neither side ever waits for the other.
+class NoteEventQueue
+{
+public:
+	struct Event
+	{
+		int channel;	// 1 to 16
+		int note;
+		float velocity;
+		bool isNoteOn;
+		double timestamp;	// Time::getMillisecondCounterHiRes() when it was played
+
+		juce::MidiMessage toMidiMessage() const;
+	};
+
+	explicit NoteEventQueue(int capacity = 1024);
+
+	// returns false, and drops the event, if the queue is full
+	bool push(const Event& e) noexcept;
+
+	// calls fn for every event pushed so far, oldest first
+	template <typename Fn>
+	void popAll(Fn&& fn) noexcept
+	{
+		fifo.read(fifo.getNumReady()).forEach([&] (int index) {
+			fn(events[(size_t) index]);
+		});
+	}
+
+	// the oldest event, or nullptr if there isn't one,
+	// left in the queue until pop() is called
+	const Event* peek() const noexcept;
+	void pop() noexcept;
+
+	int getNumDropped() const noexcept;
+
+private:
+	juce::AbstractFifo fifo;
+	std::vector<Event> events;
+	std::atomic<int> numDropped { 0 };
+
+	JUCE_DECLARE_NON_COPYABLE(NoteEventQueue)
+};
@@ -0,0 +1,164 @@
+#include "NoteStateSnapshot.h"
+
+bool NoteStateSnapshot::Notes::operator[](int note) const noexcept
+{
+	if (note < 0 || note >= 128)
+		return false;
+	return (words[note >> 6] >> (note & 63)) & 1;
+}
+
+void NoteStateSnapshot::Notes::setBit(int note, bool isOn) noexcept
+{
+	jassert (note >= 0 && note < 128);
+	auto mask = (uint64_t) 1 << (note & 63);
+	if (isOn)
+		words[note >> 6] |= mask;
+	else
+		words[note >> 6] &= ~mask;
+}
+
+int NoteStateSnapshot::Notes::findNextSetBit(int note) const noexcept
+{
+	for (note = juce::jmax(0, note); note < 128; note++) {
+		auto remaining = words[note >> 6] >> (note & 63);
+		if (remaining == 0)
+			note |= 63;	// skip to the end of this word
+		else if (remaining & 1)
+			return note;
+	}
+	return -1;
+}
+
+bool NoteStateSnapshot::Notes::isZero() const noexcept
+{
+	return (words[0] | words[1]) == 0;
+}
+
+NoteStateSnapshot::Notes NoteStateSnapshot::Notes::operator^(const Notes& other) const noexcept
+{
+	Notes n;
+	n.words[0] = words[0] ^ other.words[0];
+	n.words[1] = words[1] ^ other.words[1];
+	return n;
+}
+
+NoteStateSnapshot::Notes& NoteStateSnapshot::Notes::operator|=(const Notes& other) noexcept
+{
+	words[0] |= other.words[0];
+	words[1] |= other.words[1];
+	return *this;
+}
+
+NoteStateSnapshot::NoteStateSnapshot()
+{
+	for (auto& channel: published)
+		for (auto& word: channel)
+			word.store(0, std::memory_order_relaxed);
+	for (auto& channel: publishedVelocities)
+		for (auto& velocity: channel)
+			velocity.store(0, std::memory_order_relaxed);
+}
+
+void NoteStateSnapshot::processMidi(const juce::MidiBuffer& buffer) noexcept
+{
+	for (const auto metadata: buffer) {
+		if (metadata.numBytes < 3)
+			continue;
+
+		auto status  = metadata.data[0] & 0xf0;
+		auto channel = metadata.data[0] & 0x0f;
+		auto data1   = metadata.data[1] & 0x7f;
+		auto data2   = metadata.data[2] & 0x7f;
+
+		if (status == 0x90 && data2 > 0) {
+			working[channel].setBit(data1, true);
+			workingVelocities[channel][data1] = (uint8_t) data2;
+			hasChanged = true;
+		}
+		else if (status == 0x80 || status == 0x90) {
+			working[channel].setBit(data1, false);
+			workingVelocities[channel][data1] = 0;
+			hasChanged = true;
+		}
+		else if (status == 0xb0 && (data1 == 120 || data1 == 123)) {
+			// all sound off, all notes off
+			working[channel] = {};
+			std::fill(std::begin(workingVelocities[channel]), std::end(workingVelocities[channel]), (uint8_t) 0);
+			hasChanged = true;
+		}
+	}
+}
+
+void NoteStateSnapshot::publish() noexcept
+{
+	if (! hasChanged)
+		return;
+	hasChanged = false;
+
+	auto s = sequence.load(std::memory_order_relaxed);
+	sequence.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	for (int jChannel = 0; jChannel < 16; jChannel++) {
+		published[jChannel][0].store(working[jChannel].words[0], std::memory_order_relaxed);
+		published[jChannel][1].store(working[jChannel].words[1], std::memory_order_relaxed);
+		for (int jNote = 0; jNote < 128; jNote++)
+			publishedVelocities[jChannel][jNote].store(workingVelocities[jChannel][jNote], std::memory_order_relaxed);
+	}
+
+	sequence.store(s + 2, std::memory_order_release);
+}
+
+NoteStateSnapshot::Notes NoteStateSnapshot::getHeldNotes(int midiChannel) const noexcept
+{
+	jassert (midiChannel > 0 && midiChannel <= 16);
+	return working[midiChannel - 1];
+}
+
+uint32_t NoteStateSnapshot::getVersion() const noexcept
+{
+	return sequence.load(std::memory_order_acquire) & ~1u;
+}
+
+template <typename Fn>
+void NoteStateSnapshot::read(Fn&& fn) const noexcept
+{
+	for (;;) {
+		auto before = sequence.load(std::memory_order_acquire);
+		if (before & 1)
+			continue;
+
+		fn();
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (sequence.load(std::memory_order_relaxed) == before)
+			return;
+	}
+}
+
+NoteStateSnapshot::Notes NoteStateSnapshot::getNotesOn(int channelMask) const noexcept
+{
+	Notes notes;
+	read([&] {
+		notes = {};
+		for (int jChannel = 0; jChannel < 16; jChannel++) {
+			if (channelMask & (1 << jChannel)) {
+				notes.words[0] |= published[jChannel][0].load(std::memory_order_relaxed);
+				notes.words[1] |= published[jChannel][1].load(std::memory_order_relaxed);
+			}
+		}
+	});
+	return notes;
+}
+
+float NoteStateSnapshot::getVelocity(int midiChannel, int midiNoteNumber) const noexcept
+{
+	jassert (midiChannel > 0 && midiChannel <= 16);
+	jassert (midiNoteNumber >= 0 && midiNoteNumber < 128);
+
+	uint8_t velocity = 0;
+	read([&] {
+		velocity = publishedVelocities[midiChannel - 1][midiNoteNumber].load(std::memory_order_relaxed);
+	});
+	return velocity / 127.0f;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Which notes are held on each midi channel, as last published by the
+// audio thread. The audio thread updates its own copy from each block's
+// midi and publishes it once per block; readers on any other thread get a
+// consistent copy without locking, retrying if they overlap a publish.
+class NoteStateSnapshot
+{
+public:
+	// one bit per midi note
+	struct Notes
+	{
+		uint64_t words[2] = {};
+
+		bool operator[](int note) const noexcept;
+		void setBit(int note, bool isOn) noexcept;
+		int findNextSetBit(int note) const noexcept;	// -1 if there are none
+		bool isZero() const noexcept;
+
+		Notes operator^(const Notes& other) const noexcept;
+		Notes& operator|=(const Notes& other) noexcept;
+	};
+
+	NoteStateSnapshot();
+
+	// audio thread
+	void processMidi(const juce::MidiBuffer& buffer) noexcept;
+	void publish() noexcept;
+	Notes getHeldNotes(int midiChannel) const noexcept;	// as of the last processMidi, not the last publish
+
+	// any thread
+	uint32_t getVersion() const noexcept;	// changes each time something new is published
+	Notes getNotesOn(int channelMask) const noexcept;
+	float getVelocity(int midiChannel, int midiNoteNumber) const noexcept;
+
+private:
+	template <typename Fn>
+	void read(Fn&& fn) const noexcept;
+
+	// only touched by the audio thread
+	Notes working[16];
+	uint8_t workingVelocities[16][128] = {};
+	bool hasChanged = false;
+
+	// odd while a publish is in progress
+	std::atomic<uint32_t> sequence { 0 };
+	std::atomic<uint64_t> published[16][2];
+	std::atomic<uint8_t> publishedVelocities[16][128];
+
+	JUCE_DECLARE_NON_COPYABLE(NoteStateSnapshot)
+};
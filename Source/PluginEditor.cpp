@@ -13,14 +13,12 @@
 ChromakbdAudioProcessorEditor::ChromakbdAudioProcessorEditor (ChromakbdAudioProcessor& p) :
 	AudioProcessorEditor (&p),
 	audioProcessor (p),
-	keyboardComponent(p.keyboardState, ChromaKeyboard::horizontal)
+	keyboardComponent(p.uiNoteEvents, p.noteStates, ChromaKeyboard::horizontal)
 {
 	addAndMakeVisible(keyboardComponent);
-	keyboardComponent.setLayout(ChromaKeyboard::guitar);
 
 	addAndMakeVisible(baseInput);
 	baseInput.setEditable(true);
-	baseInput.setText(juce::String(base), juce::sendNotificationAsync);
 	baseInput.onEditorShow = [this] {
 		baseInput.getCurrentTextEditor()->setInputRestrictions(2, "0123456789");
 	};
@@ -31,21 +29,222 @@ ChromakbdAudioProcessorEditor::ChromakbdAudioProcessorEditor (ChromakbdAudioProc
 	addAndMakeVisible(baseLabel);
 	baseLabel.attachToComponent(&baseInput, true);
 
-	setSize (800, 100);
+	addAndMakeVisible(fixedLatencyToggle);
+	fixedLatencyToggle.setWantsKeyboardFocus(false);
+	fixedLatencyToggle.setToggleState(audioProcessor.hasFixedLatencyTiming(), juce::dontSendNotification);
+	fixedLatencyToggle.onClick = [this] {
+		audioProcessor.setFixedLatencyTiming(fixedLatencyToggle.getToggleState());
+	};
+
+	addAndMakeVisible(mpeToggle);
+	mpeToggle.setWantsKeyboardFocus(false);
+	mpeAttachment = std::make_unique<juce::ButtonParameterAttachment>(
+		*audioProcessor.parameters.getParameter("mpe"), mpeToggle);
+
+	addAndMakeVisible(mtsSelector);
+	mtsSelector.setWantsKeyboardFocus(false);
+	mtsSelector.addItemList({ "MTS off", "MTS dump", "MTS notes" }, 1);
+	mtsAttachment = std::make_unique<juce::ComboBoxParameterAttachment>(
+		*audioProcessor.parameters.getParameter("mts"), mtsSelector);
+
+	addAndMakeVisible(tuningButton);
+	tuningButton.setWantsKeyboardFocus(false);
+	tuningButton.onClick = [this] { showTuningPanel(); };
+
+	addAndMakeVisible(programSelector);
+	programSelector.setWantsKeyboardFocus(false);
+	for (int jProgram = 0; jProgram < audioProcessor.programs.size(); jProgram++)
+		programSelector.addItem(audioProcessor.getProgramName(jProgram), jProgram + 1);
+	programSelector.setSelectedId(audioProcessor.getCurrentProgram() + 1, juce::dontSendNotification);
+	programSelector.onChange = [this] {
+		audioProcessor.setCurrentProgram(programSelector.getSelectedId() - 1);
+		audioProcessor.updateHostDisplay(juce::AudioProcessorListener::ChangeDetails().withProgramChanged(true));
+	};
+	addAndMakeVisible(programLabel);
+	programLabel.attachToComponent(&programSelector, true);
+
+	if (juce::JUCEApplicationBase::isStandaloneApp()) {
+		addAndMakeVisible(keySourceSelector);
+		keySourceSelector.setWantsKeyboardFocus(false);
+		keySourceSelector.addItem("this window", 1);
+		keyboardDevices = EvdevKeyReader::findKeyboards();
+		for (int jDevice = 0; jDevice < keyboardDevices.size(); jDevice++)
+			keySourceSelector.addItem(keyboardDevices[jDevice].getFileName(), jDevice + 2);
+		auto deviceIndex = audioProcessor.isKeyReaderOpen(0)
+			? keyboardDevices.indexOf(audioProcessor.getKeyReaderDevice(0))
+			: -1;
+		keySourceSelector.setSelectedId(deviceIndex + 2, juce::dontSendNotification);
+		keySourceSelector.onChange = [this] { keySourceChanged(); };
+		addAndMakeVisible(keySourceLabel);
+		keySourceLabel.attachToComponent(&keySourceSelector, true);
+
+		addAndMakeVisible(zonesButton);
+		zonesButton.setWantsKeyboardFocus(false);
+		zonesButton.onClick = [this] { showZonePanel(); };
+
+		addAndMakeVisible(jackOutputToggle);
+		jackOutputToggle.setWantsKeyboardFocus(false);
+		jackOutputToggle.setToggleState(audioProcessor.isJackOutputOpen(), juce::dontSendNotification);
+		jackOutputToggle.onClick = [this] { jackOutputToggled(); };
+	}
+
+	// a program's parameters wait for programChanges, in applyProgram()
+	baseAttachment = attach("base", [this] (float value) {
+		if (audioProcessor.isChangingProgram())
+			return;
+		updatePalette();
+		keyboardComponent.setBase((int) value);
+		baseInput.setText(juce::String((int) value), juce::dontSendNotification);
+	});
+	layoutAttachment = attach("layout", [this] (float) {
+		if (! audioProcessor.isChangingProgram())
+			updateKeyMap();
+	});
+	keyMapBaseAttachment = attach("keyMapBase", [this] (float value) {
+		if (! audioProcessor.isChangingProgram())
+			keyboardComponent.setKeyMapBase((int) value);
+	});
+	velocityAttachment = attach("velocity", [this] (float value) {
+		keyboardComponent.setVelocity(value, true);
+	});
+	midiChannelAttachment = attach("midiChannel", [this] (float value) {
+		if (! audioProcessor.isChangingProgram())
+			keyboardComponent.setMidiChannel((int) value);
+	});
+	auto setRange = [this] (float) {
+		if (! audioProcessor.isChangingProgram())
+			updateRange();
+	};
+	rangeStartAttachment = attach("rangeStart", setRange);
+	rangeEndAttachment = attach("rangeEnd", setRange);
+
+	keyboardComponent.onLayoutChange = [this] {
+		layoutAttachment->setValueAsCompleteGesture((float) keyboardComponent.getLayout() - 1);
+	};
+	keyboardComponent.onKeyMapBaseChange = [this] {
+		keyMapBaseAttachment->setValueAsCompleteGesture((float) keyboardComponent.getKeyMapBase());
+	};
+
+	setSize (juce::JUCEApplicationBase::isStandaloneApp() ? 1400 : 988, 100);
+
+	keyboardComponent.setLowestVisibleKey(audioProcessor.getLowestVisibleKey());
+	keyboardComponent.addChangeListener(this);
+	audioProcessor.programChanges.addChangeListener(this);
+	keyboardComponent.setTuning(audioProcessor.getScalaTuning());
+	audioProcessor.tuningChanges.addChangeListener(this);
+
 	startTimer(400);
 }
 
 ChromakbdAudioProcessorEditor::~ChromakbdAudioProcessorEditor()
 {
+	audioProcessor.tuningChanges.removeChangeListener(this);
+	audioProcessor.programChanges.removeChangeListener(this);
+	keyboardComponent.removeChangeListener(this);
+}
+
+std::unique_ptr<juce::ParameterAttachment> ChromakbdAudioProcessorEditor::attach(
+	const juce::String& parameterID,
+	std::function<void(float)> onParameterChange )
+{
+	auto* parameter = audioProcessor.parameters.getParameter(parameterID);
+	jassert (parameter != nullptr);
+	auto attachment = std::make_unique<juce::ParameterAttachment>(*parameter, std::move(onParameterChange));
+	attachment->sendInitialUpdate();
+	return attachment;
+}
+
+const ChromaProgramBank::Program& ChromakbdAudioProcessorEditor::getCurrentProgram() const
+{
+	return audioProcessor.programs[audioProcessor.getCurrentProgram()];
+}
+
+void ChromakbdAudioProcessorEditor::updatePalette()
+{
+	keyboardComponent.setPalette(getCurrentProgram().palette);
+}
+
+// uses the current program's key map when the layout still matches it
+void ChromakbdAudioProcessorEditor::updateKeyMap()
+{
+	auto layout = (ChromaKeyMap::Layout) audioProcessor.getLayout();
+	auto& program = getCurrentProgram();
+
+	if (program.layout == layout)
+		keyboardComponent.setKeyMap(layout, program.keyMap);
+	else
+		keyboardComponent.setKeyMap(layout, ChromaKeyMap::makeKeyMap(layout));
+}
+
+void ChromakbdAudioProcessorEditor::updateRange()
+{
+	auto start = audioProcessor.getRangeStart(), end = audioProcessor.getRangeEnd();
+	keyboardComponent.setAvailableRange(juce::jmin(start, end), juce::jmax(start, end));
+}
+
+// everything a program sets, in one go, so the keyboard is rebuilt once
+void ChromakbdAudioProcessorEditor::applyProgram()
+{
+	programSelector.setSelectedId(audioProcessor.getCurrentProgram() + 1, juce::dontSendNotification);
+	updatePalette();
+	keyboardComponent.setBase(audioProcessor.getBase());
+	baseInput.setText(juce::String(audioProcessor.getBase()), juce::dontSendNotification);
+	updateKeyMap();
+	keyboardComponent.setKeyMapBase(audioProcessor.getKeyMapBase());
+	keyboardComponent.setMidiChannel(audioProcessor.getMidiChannel());
+	updateRange();
+}
+
+void ChromakbdAudioProcessorEditor::keySourceChanged()
+{
+	auto index = keySourceSelector.getSelectedId() - 2;
+	if (! juce::isPositiveAndBelow(index, keyboardDevices.size())) {
+		audioProcessor.closeKeyReader(0);
+		return;
+	}
+
+	auto error = audioProcessor.openKeyReader(0, keyboardDevices[index]);
+	if (error.isNotEmpty()) {
+		keySourceSelector.setSelectedId(1, juce::dontSendNotification);
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Can't read keyboard", error);
+	}
+}
+
+void ChromakbdAudioProcessorEditor::showZonePanel()
+{
+	juce::CallOutBox::launchAsynchronously(
+		std::make_unique<ChromaZonePanel>(audioProcessor),
+		zonesButton.getScreenBounds(),
+		nullptr );
+}
+
+void ChromakbdAudioProcessorEditor::showTuningPanel()
+{
+	juce::CallOutBox::launchAsynchronously(
+		std::make_unique<ChromaTuningPanel>(audioProcessor),
+		tuningButton.getScreenBounds(),
+		nullptr );
+}
+
+void ChromakbdAudioProcessorEditor::jackOutputToggled()
+{
+	if (! jackOutputToggle.getToggleState()) {
+		audioProcessor.closeJackOutput();
+		return;
+	}
+
+	auto error = audioProcessor.openJackOutput();
+	if (error.isNotEmpty()) {
+		jackOutputToggle.setToggleState(false, juce::dontSendNotification);
+		juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon, "Can't open JACK output", error);
+	}
 }
 
 void ChromakbdAudioProcessorEditor::baseInputChanged() {
 	juce::BigInteger parsed; parsed.parseString(baseInput.getText(), 10);
-	if (0 < parsed.toInt64()) {
-		base = parsed.toInt64();
-		keyboardComponent.setBase(base);
-	}
-	baseInput.setText(juce::String(base), juce::dontSendNotification);
+	if (0 < parsed.toInt64())
+		baseAttachment->setValueAsCompleteGesture((float) parsed.toInt64());
+	baseInput.setText(juce::String(audioProcessor.getBase()), juce::dontSendNotification);
 }
 
 //==============================================================================
@@ -63,6 +262,14 @@ void ChromakbdAudioProcessorEditor::resized()
 		getHeight());
 
 	baseInput.setBounds(256, 0, 64, keyboardComponent.optionBarHeight);
+	fixedLatencyToggle.setBounds(336, 0, 128, keyboardComponent.optionBarHeight);
+	mpeToggle.setBounds(472, 0, 64, keyboardComponent.optionBarHeight);
+	mtsSelector.setBounds(544, 0, 112, keyboardComponent.optionBarHeight);
+	tuningButton.setBounds(664, 0, 80, keyboardComponent.optionBarHeight);
+	programSelector.setBounds(808, 0, 160, keyboardComponent.optionBarHeight);
+	keySourceSelector.setBounds(1016, 0, 160, keyboardComponent.optionBarHeight);
+	zonesButton.setBounds(1184, 0, 72, keyboardComponent.optionBarHeight);
+	jackOutputToggle.setBounds(1264, 0, 128, keyboardComponent.optionBarHeight);
 }
 
 
@@ -71,6 +278,20 @@ void ChromakbdAudioProcessorEditor::focusGained(FocusChangeType cause)
 	keyboardComponent.grabKeyboardFocus();
 }
 
+void ChromakbdAudioProcessorEditor::changeListenerCallback(juce::ChangeBroadcaster* source)
+{
+	if (source == &audioProcessor.programChanges) {
+		applyProgram();
+	}
+	else if (source == &audioProcessor.tuningChanges) {
+		keyboardComponent.setTuning(audioProcessor.getScalaTuning());
+	}
+	else {
+		// the keyboard has scrolled
+		audioProcessor.setLowestVisibleKey(keyboardComponent.getLowestVisibleKey());
+	}
+}
+
 void ChromakbdAudioProcessorEditor::timerCallback()
 {
 	if (keyboardComponent.isShowing()) {
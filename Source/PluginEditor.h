@@ -11,12 +11,15 @@
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
 #include "ChromaKeyboard.h"
+#include "ChromaZonePanel.h"
+#include "ChromaTuningPanel.h"
 
 //==============================================================================
 /**
 */
 class ChromakbdAudioProcessorEditor  :
 	public juce::AudioProcessorEditor,
+	private juce::ChangeListener,
 	private juce::Timer
 {
 public:
@@ -36,10 +39,48 @@ private:
 
 	ChromaKeyboard keyboardComponent;
 
-	int base = 12;
+	const ChromaProgramBank::Program& getCurrentProgram() const;
+	void updatePalette();
+	void updateKeyMap();
+	void updateRange();
+	void applyProgram();
+	void keySourceChanged();
+	void showZonePanel();
+	void showTuningPanel();
+	void jackOutputToggled();
+
+	// keep the keyboard in step with the processor's parameters
+	std::unique_ptr<juce::ParameterAttachment> attach(
+		const juce::String& parameterID,
+		std::function<void(float)> onParameterChange );
+	std::unique_ptr<juce::ParameterAttachment>
+		baseAttachment,
+		layoutAttachment,
+		keyMapBaseAttachment,
+		velocityAttachment,
+		midiChannelAttachment,
+		rangeStartAttachment,
+		rangeEndAttachment;
+
 	juce::Label baseLabel { {}, "base:"};
 	juce::Label baseInput;
+	juce::ToggleButton fixedLatencyToggle { "steady timing" };
+	juce::ToggleButton mpeToggle { "MPE" };
+	std::unique_ptr<juce::ButtonParameterAttachment> mpeAttachment;
+	juce::ComboBox mtsSelector;
+	std::unique_ptr<juce::ComboBoxParameterAttachment> mtsAttachment;
+	juce::TextButton tuningButton { "tuning..." };
+	juce::ComboBox programSelector;
+	juce::Label programLabel { {}, "program:" };
+
+	// Standalone only: where computer keys are read from
+	juce::ComboBox keySourceSelector;
+	juce::Label keySourceLabel { {}, "keys:" };
+	juce::Array<juce::File> keyboardDevices;
+	juce::TextButton zonesButton { "zones..." };
+	juce::ToggleButton jackOutputToggle { "JACK MIDI out" };
 
+	void changeListenerCallback(juce::ChangeBroadcaster*) override;
 	void timerCallback() override;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChromakbdAudioProcessorEditor)
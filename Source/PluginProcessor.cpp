@@ -14,12 +14,137 @@ ChromakbdAudioProcessor::ChromakbdAudioProcessor()
                        )
 #endif
 {
+    baseValue        = parameters.getRawParameterValue ("base");
+    layoutValue      = parameters.getRawParameterValue ("layout");
+    keyMapBaseValue  = parameters.getRawParameterValue ("keyMapBase");
+    velocityValue    = parameters.getRawParameterValue ("velocity");
+    midiChannelValue = parameters.getRawParameterValue ("midiChannel");
+    rangeStartValue  = parameters.getRawParameterValue ("rangeStart");
+    rangeEndValue    = parameters.getRawParameterValue ("rangeEnd");
+    mpeValue         = parameters.getRawParameterValue ("mpe");
+    mtsValue         = parameters.getRawParameterValue ("mts");
+
+    for (size_t i = 0; i < stateParameterPointers.size(); ++i)
+        stateParameterPointers[i] = parameters.getParameter (stateParameters[i].parameterID);
+
+    noteSources[0] = &uiNoteEvents;
+    for (size_t i = 0; i < keyReaders.size(); ++i)
+    {
+        keyReaders[i] = std::make_unique<KeyReaderSlot> (*this);
+        noteSources[i + 1] = &keyReaders[i]->events;
+    }
+
+    const char* tuningParameterIDs[] = { "base", "mts" };
+    for (size_t i = 0; i < tuningAttachments.size(); ++i)
+        tuningAttachments[i] = std::make_unique<juce::ParameterAttachment> (*parameters.getParameter (tuningParameterIDs[i]),
+                                                                            [this] (float) { updateTuning(); });
+    updateTuning();
+
+    scalaLoader.onLoaded = [this] (std::shared_ptr<const ChromaScala::Tuning> tuning, const juce::String& error)
+    {
+        // cleared while it was loading
+        if (scalaScaleFile == juce::File())
+            return;
+
+        scalaError = error;
+        if (tuning != nullptr)
+            scalaTuning = std::move (tuning);
+        updateTuning();
+        tuningChanges.sendChangeMessage();
+    };
+    scalaLoader.onIndexed = [this] (const juce::File& folder, const juce::Array<ChromaScala::IndexEntry>& entries)
+    {
+        scalaFolder = folder;
+        scalaIndex = entries;
+        tuningChanges.sendChangeMessage();
+    };
+
+    // enough for the JACK output, which never calls prepareToPlay()
+    sourceMessages.ensureSize ((size_t) maxNoteEventsPerBlock * bytesPerMidiEvent);
 }
 
 ChromakbdAudioProcessor::~ChromakbdAudioProcessor()
 {
+    jackOutput.close();
+
+    // stop every reader before any of their queues go
+    for (auto& slot : keyReaders)
+        slot->reader.close();
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout ChromakbdAudioProcessor::createParameterLayout()
+{
+    // layout choices are in ChromaKeyMap::Layout order, which starts at 1
+    juce::StringArray layouts { "linear", "guitar", "organ", "harpejji", "hexagonal" };
+
+    return {
+        std::make_unique<juce::AudioParameterInt>    (juce::ParameterID { "base", 1 }, "Base", 1, 99, 12),
+        std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { "layout", 1 }, "Layout", layouts, 1),
+        std::make_unique<juce::AudioParameterInt>    (juce::ParameterID { "keyMapBase", 1 }, "Key Map Base", 0, 127, 52),
+        std::make_unique<juce::AudioParameterFloat>  (juce::ParameterID { "velocity", 1 }, "Velocity", 0.0f, 1.0f, 1.0f),
+        std::make_unique<juce::AudioParameterInt>    (juce::ParameterID { "midiChannel", 1 }, "MIDI Channel", 1, 16, 1),
+        std::make_unique<juce::AudioParameterInt>    (juce::ParameterID { "rangeStart", 1 }, "Range Start", 0, 127, 0),
+        std::make_unique<juce::AudioParameterInt>    (juce::ParameterID { "rangeEnd", 1 }, "Range End", 0, 127, 127),
+        std::make_unique<juce::AudioParameterBool>   (juce::ParameterID { "mpe", 1 }, "MPE Output", false),
+        std::make_unique<juce::AudioParameterChoice> (juce::ParameterID { "mts", 1 }, "MTS Output",
+                                                      juce::StringArray { "off", "bulk dump", "note changes" }, 0),
+    };
+}
+
+int ChromakbdAudioProcessor::getBase() const noexcept          { return (int) baseValue->load(); }
+int ChromakbdAudioProcessor::getLayout() const noexcept        { return (int) layoutValue->load() + 1; }
+int ChromakbdAudioProcessor::getKeyMapBase() const noexcept    { return (int) keyMapBaseValue->load(); }
+float ChromakbdAudioProcessor::getVelocity() const noexcept    { return velocityValue->load(); }
+int ChromakbdAudioProcessor::getMidiChannel() const noexcept   { return (int) midiChannelValue->load(); }
+int ChromakbdAudioProcessor::getRangeStart() const noexcept    { return (int) rangeStartValue->load(); }
+int ChromakbdAudioProcessor::getRangeEnd() const noexcept      { return (int) rangeEndValue->load(); }
+bool ChromakbdAudioProcessor::isMpeEnabled() const noexcept    { return mpeValue->load() >= 0.5f; }
+ChromaMtsOutput::Mode ChromakbdAudioProcessor::getMtsMode() const noexcept { return (ChromaMtsOutput::Mode) (int) mtsValue->load(); }
+
+// message thread, from the tuning attachments
+void ChromakbdAudioProcessor::updateTuning()
+{
+    if (scalaTuning != nullptr)
+    {
+        mpeOutput.setTuning (scalaTuning);
+        mtsOutput.setTuning (getMtsMode(), scalaTuning);
+    }
+    else
+    {
+        mpeOutput.setBase (getBase());
+        mtsOutput.setTuning (getMtsMode(), getBase());
+    }
+}
+
+void ChromakbdAudioProcessor::loadScalaTuning (const juce::File& scale, const juce::File& keyboardMapping)
+{
+    scalaScaleFile = scale;
+    scalaMappingFile = keyboardMapping;
+    scalaLoader.load (scale, keyboardMapping);
+}
+
+void ChromakbdAudioProcessor::clearScalaTuning()
+{
+    scalaScaleFile = scalaMappingFile = juce::File();
+    scalaError = {};
+    scalaTuning = nullptr;
+    updateTuning();
+    tuningChanges.sendChangeMessage();
+}
+
+std::shared_ptr<const ChromaScala::Tuning> ChromakbdAudioProcessor::getScalaTuning() const { return scalaTuning; }
+juce::File ChromakbdAudioProcessor::getScalaScaleFile() const                           { return scalaScaleFile; }
+juce::File ChromakbdAudioProcessor::getScalaMappingFile() const                         { return scalaMappingFile; }
+juce::String ChromakbdAudioProcessor::getScalaError() const                             { return scalaError; }
+
+void ChromakbdAudioProcessor::indexScalaFolder (const juce::File& folder)
+{
+    scalaLoader.index (folder);
 }
 
+juce::File ChromakbdAudioProcessor::getScalaFolder() const                              { return scalaFolder; }
+const juce::Array<ChromaScala::IndexEntry>& ChromakbdAudioProcessor::getScalaIndex() const { return scalaIndex; }
+
 //==============================================================================
 const juce::String ChromakbdAudioProcessor::getName() const
 {
@@ -60,33 +185,98 @@ double ChromakbdAudioProcessor::getTailLengthSeconds() const
 
 int ChromakbdAudioProcessor::getNumPrograms()
 {
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
+    return programs.size();
 }
 
 int ChromakbdAudioProcessor::getCurrentProgram()
 {
-    return 0;
+    return currentProgram.load();
 }
 
 void ChromakbdAudioProcessor::setCurrentProgram (int index)
 {
+    if (! juce::isPositiveAndBelow (index, programs.size()))
+        return;
+
+    // set first, so the editor picks up the program's palette along with its base
+    currentProgram = index;
+    requestedProgram = index;
+
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        applyRequestedProgram();
+    else
+        triggerAsyncUpdate();
+}
+
+// message thread: sets the latest requested program's parameters as one
+// gesture, then tells the editor once
+void ChromakbdAudioProcessor::applyRequestedProgram()
+{
+    auto index = requestedProgram.exchange (-1);
+    if (index < 0)
+        return;
+
+    auto& program = programs[index];
+    const std::pair<const char*, float> values[] = {
+        { "base",        (float) program.base },
+        { "layout",      (float) program.layout - 1 },
+        { "keyMapBase",  (float) program.keyMapBase },
+        { "midiChannel", (float) program.midiChannel },
+        { "rangeStart",  (float) program.rangeStart },
+        { "rangeEnd",    (float) program.rangeEnd },
+    };
+
+    for (auto& [parameterID, value] : values)
+        parameters.getParameter (parameterID)->beginChangeGesture();
+
+    changingProgram = true;
+    for (auto& [parameterID, value] : values)
+    {
+        auto* parameter = parameters.getParameter (parameterID);
+        parameter->setValueNotifyingHost (parameter->convertTo0to1 (value));
+    }
+    changingProgram = false;
+
+    for (auto& [parameterID, value] : values)
+        parameters.getParameter (parameterID)->endChangeGesture();
+
+    programChanges.sendSynchronousChangeMessage();
+}
+
+bool ChromakbdAudioProcessor::isChangingProgram() const noexcept
+{
+    return changingProgram;
 }
 
 const juce::String ChromakbdAudioProcessor::getProgramName (int index)
 {
-    return {};
+    if (! juce::isPositiveAndBelow (index, programs.size()))
+        return {};
+    const juce::ScopedLock sl (programNamesLock);
+    return programs[index].name;
 }
 
 void ChromakbdAudioProcessor::changeProgramName (int index, const juce::String& newName)
 {
+    if (! juce::isPositiveAndBelow (index, programs.size()))
+        return;
+    const juce::ScopedLock sl (programNamesLock);
+    programs.setName (index, newName);
 }
 
 //==============================================================================
 void ChromakbdAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    currentSampleRate = sampleRate;
+    maxBlockSize = samplesPerBlock;
+
+    // Leave room for the worst case of editor notes, plus one incoming
+    // message per sample, as many as MPE turns it into, and one tuning message.
+    midiByteBudget = (maxNoteEventsPerBlock + samplesPerBlock * ChromaMpeOutput::maxMessagesPerEvent) * bytesPerMidiEvent
+                       + maxTuningMessageBytes;
+    sourceMessages.ensureSize ((size_t) midiByteBudget);
+    hostMessages.ensureSize ((size_t) midiByteBudget);
+    spareMessages.ensureSize ((size_t) midiByteBudget);
 }
 
 void ChromakbdAudioProcessor::releaseResources()
@@ -123,7 +313,187 @@ bool ChromakbdAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts
 
 void ChromakbdAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
-	keyboardState.processNextMidiBuffer(midiMessages, 0, buffer.getNumSamples(), true);
+	// while the JACK output is open its own callback plays the notes, and
+	// the host's input passes straight through
+	if (jackOutput.isOpen())
+		return;
+
+	// The host's input is moved aside and merged back in with the queued
+	// notes. Swapping only exchanges storage, so the output goes into
+	// storage prepareToPlay() set aside. Hosts reuse the same buffer every
+	// block, so their own storage comes round again a block later; if it's
+	// too small for the budget it's parked in place of the spare, rather
+	// than grown here.
+	hostMessages.clear();
+	hostMessages.swapWith(midiMessages);
+	if (midiMessages.data.getNumAllocated() < midiByteBudget)
+		midiMessages.swapWith(spareMessages);
+
+	renderNoteEvents(
+		midiMessages,
+		buffer.getNumSamples(),
+		currentSampleRate,
+		maxBlockSize,
+		juce::Time::getMillisecondCounterHiRes(),
+		midiByteBudget,
+		&hostMessages );
+}
+
+void ChromakbdAudioProcessor::renderNoteEvents (juce::MidiBuffer& midiMessages, int numSamples, double sampleRate,
+                                                int latencySamples, double blockStartTime, int byteBudget,
+                                                const juce::MidiBuffer* input)
+{
+	// the queues have a single reader, so never two of us at once
+	if (renderingNotes.exchange(true, std::memory_order_acquire)) {
+		if (input != nullptr)
+			midiMessages.addEvents(*input, 0, -1, 0);
+		return;
+	}
+
+	// Switching MPE on sets the synth up for it; switching it off stops
+	// whatever it was playing. Until that fits in a block, notes stay as they were.
+	auto useMpe = isMpeEnabled();
+	if (useMpe != mpeWasEnabled) {
+		auto bytesNeeded = useMpe
+			? (int) mpeOutput.getSetupMessages().data.size()
+			: ChromaMpeOutput::numMemberChannels * bytesPerMidiEvent;
+		if (midiMessages.data.size() + bytesNeeded <= byteBudget) {
+			mpeSwitchOverflowed = false;
+			if (useMpe) {
+				mpeOutput.start(noteStates);
+				midiMessages.addEvents(mpeOutput.getSetupMessages(), 0, -1, 0);
+			}
+			else
+				mpeOutput.releaseAll(midiMessages, 0);
+			mpeWasEnabled = useMpe;
+		}
+		else if (! mpeSwitchOverflowed) {
+			mpeSwitchOverflowed = true;
+			numMidiOverflows++;
+		}
+	}
+
+	// MTS retunes the synth before any notes; MPE tunes each note itself
+	if (! mpeWasEnabled)
+		mtsOutput.render(midiMessages, numSamples, sampleRate, byteBudget);
+
+	// never grows the buffer past the budget; events that don't fit stay queued
+	auto hasRoomFor = [&] (int bytesNeeded) {
+		return midiMessages.data.size() + bytesNeeded <= byteBudget;
+	};
+	auto bytesPerNoteEvent = mpeWasEnabled ? ChromaMpeOutput::maxMessagesPerEvent * bytesPerMidiEvent : bytesPerMidiEvent;
+
+	auto playEvent = [&] (const NoteEventQueue::Event& e, int offset) {
+		if (mpeWasEnabled) {
+			mpeOutput.process(e, midiMessages, offset);
+			sourceMessages.addEvent(e.toMidiMessage(), offset);
+		}
+		else {
+			midiMessages.addEvent(e.toMidiMessage(), offset);
+		}
+	};
+
+	auto addEvent = [&] (const NoteEventQueue::Event& e, int offset) {
+		if (! hasRoomFor(bytesPerNoteEvent))
+			return false;
+		playEvent(e, offset);
+		return true;
+	};
+
+	// The host's input, merged in by sample position in the same pass. Its
+	// notes go the same way as the keyboard's; anything else goes out as it
+	// came. It can't wait for a later block, so what doesn't fit the budget,
+	// which has room for a message per sample, is dropped and counted as an
+	// overflow. While MPE is on the member channels belong to the voices,
+	// so channel messages go to the master channel instead, and poly
+	// pressure, whose key now sounds on some other channel, is dropped.
+	auto& hostInput = input != nullptr ? *input : noInput;
+	auto hostEvent = hostInput.cbegin();
+
+	auto addHostEventsUpTo = [&] (int offset) {
+		for (; hostEvent != hostInput.cend() && (*hostEvent).samplePosition <= offset; ++hostEvent) {
+			auto m = *hostEvent;
+			auto status = m.data[0] & 0xf0;
+			auto isNote = (status == 0x90 || status == 0x80) && m.numBytes == 3;
+			if (! hasRoomFor(isNote ? bytesPerNoteEvent : bytesPerMidiEvent - 3 + m.numBytes)) {
+				numMidiOverflows++;
+				continue;
+			}
+
+			if (isNote) {
+				auto isNoteOn = status == 0x90 && m.data[2] > 0;
+				playEvent({ (m.data[0] & 0x0f) + 1, m.data[1], m.data[2] / 127.0f, isNoteOn, blockStartTime }, m.samplePosition);
+			}
+			else if (mpeWasEnabled && status >= 0xa0 && status < 0xf0 && m.numBytes <= 3) {
+				if (status == 0xa0)
+					continue;
+				juce::uint8 bytes[3] = {};
+				std::copy(m.data, m.data + m.numBytes, bytes);
+				bytes[0] = (juce::uint8) (status | (ChromaMpeOutput::masterChannel - 1));
+				midiMessages.addEvent(bytes, m.numBytes, m.samplePosition);
+			}
+			else {
+				midiMessages.addEvent(m.data, m.numBytes, m.samplePosition);
+			}
+		}
+	};
+
+	auto useFixedLatency = fixedLatencyTiming.load();
+
+	// every source of notes, merged in the order the notes were played
+	for (;;) {
+		NoteEventQueue* source = nullptr;
+		const NoteEventQueue::Event* e = nullptr;
+		for (auto* queue: noteSources) {
+			auto* next = queue->peek();
+			if (next != nullptr && (e == nullptr || next->timestamp < e->timestamp))
+				source = queue, e = next;
+		}
+		if (e == nullptr)
+			break;
+
+		int offset = 0;
+		if (useFixedLatency) {
+			// place each note a fixed latency after it was played, so its
+			// position in the block depends on when it was played rather than
+			// on when the message thread happened to run
+			offset = latencySamples
+				+ (int) std::round((e->timestamp - blockStartTime) * sampleRate / 1000.0);
+			if (offset >= numSamples)
+				break;	// due in a later block, like everything after it
+			offset = juce::jmax(0, offset);
+		}
+
+		addHostEventsUpTo(offset);
+		if (! addEvent(*e, offset)) {
+			// it stays at the head of its queue until it fits, so it's
+			// only counted the first time
+			if (e != overflowedEvent)
+				numMidiOverflows++;
+			overflowedEvent = e;
+			break;
+		}
+		if (e == overflowedEvent)
+			overflowedEvent = nullptr;
+		source->pop();
+	}
+	addHostEventsUpTo(std::numeric_limits<int>::max());
+
+	// the keyboard shows keys, not the notes MPE moved them to
+	if (mpeWasEnabled) {
+		noteStates.processMidi(sourceMessages);
+		sourceMessages.clear();
+	}
+	else {
+		noteStates.processMidi(midiMessages);
+	}
+	noteStates.publish();
+
+	// this block is done with any table replaced before it, so those can go
+	mpeOutput.blockDone();
+	mtsOutput.blockDone();
+
+	renderingNotes.store(false, std::memory_order_release);
 }
 
 //==============================================================================
@@ -140,15 +510,205 @@ juce::AudioProcessorEditor* ChromakbdAudioProcessor::createEditor()
 //==============================================================================
 void ChromakbdAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    juce::MemoryOutputStream out (destData, false);
+    out.writeInt (stateMagic);
+    out.writeByte ((char) stateVersion);
+
+    auto writeRecord = [&out] (StateTag tag, float value)
+    {
+        out.writeByte ((char) tag);
+        out.writeByte ((char) sizeof (float));
+        out.writeFloat (value);
+    };
+
+    for (size_t i = 0; i < stateParameterPointers.size(); ++i)
+    {
+        auto* parameter = stateParameterPointers[i];
+        writeRecord (stateParameters[i].tag, parameter->convertFrom0to1 (parameter->getValue()));
+    }
+
+    writeRecord (lowestVisibleKeyTag, (float) lowestVisibleKey.load());
+    writeRecord (fixedLatencyTimingTag, fixedLatencyTiming.load() ? 1.0f : 0.0f);
+    writeRecord (programTag, (float) currentProgram.load());
+
+    // paths too long for a record aren't saved
+    auto writeString = [&out] (StateTag tag, const juce::String& text)
+    {
+        auto size = text.getNumBytesAsUTF8();
+        if (size == 0 || size > 255)
+            return;
+        out.writeByte ((char) tag);
+        out.writeByte ((char) size);
+        out.write (text.toRawUTF8(), size);
+    };
+
+    writeString (scalaScaleTag, scalaScaleFile.getFullPathName());
+    writeString (scalaMappingTag, scalaMappingFile.getFullPathName());
 }
 
 void ChromakbdAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    juce::MemoryInputStream in (data, (size_t) juce::jmax (0, sizeInBytes), false);
+
+    // anything that isn't ours is left alone, rather than half applied
+    if (sizeInBytes < 5 || in.readInt() != stateMagic || (juce::uint8) in.readByte() == 0)
+        return;
+
+    juce::File scale, mapping;
+
+    // records are read whatever the format version: ones from newer builds
+    // that we don't know about are skipped by their size
+    while (in.getNumBytesRemaining() >= 2)
+    {
+        auto tag = (juce::uint8) in.readByte();
+        auto size = (juce::uint8) in.readByte();
+
+        if (in.getNumBytesRemaining() < size)
+            break;  // truncated
+
+        auto recordEnd = in.getPosition() + size;
+
+        if (tag == scalaScaleTag || tag == scalaMappingTag)
+        {
+            auto path = juce::String::fromUTF8 (static_cast<const char*> (data) + in.getPosition(), size);
+            if (juce::File::isAbsolutePath (path))
+                (tag == scalaScaleTag ? scale : mapping) = juce::File (path);
+        }
+        else if (size == sizeof (float))
+        {
+            auto value = in.readFloat();
+
+            if (std::isfinite (value))
+            {
+                if (tag == lowestVisibleKeyTag)
+                    lowestVisibleKey = juce::jlimit (0, 127, (int) value);
+                else if (tag == fixedLatencyTimingTag)
+                    fixedLatencyTiming = value != 0.0f;
+                else if (tag == programTag)
+                {
+                    // only the index: the parameters are restored as they were saved
+                    currentProgram = juce::jlimit (0, programs.size() - 1, (int) value);
+                    programChanges.sendChangeMessage();
+                }
+                else
+                    for (size_t i = 0; i < stateParameterPointers.size(); ++i)
+                        if (stateParameters[i].tag == tag)
+                            stateParameterPointers[i]->setValueNotifyingHost (
+                                stateParameterPointers[i]->convertTo0to1 (value));
+            }
+        }
+
+        in.setPosition (recordEnd);
+    }
+
+    {
+        const juce::ScopedLock sl (restoredScalaLock);
+        restoredScaleFile = scale;
+        restoredMappingFile = mapping;
+        hasRestoredScala = true;
+    }
+
+    if (juce::MessageManager::existsAndIsCurrentThread())
+        applyRestoredScalaTuning();
+    else
+        triggerAsyncUpdate();
+}
+
+// message thread, with the files from the latest setStateInformation()
+void ChromakbdAudioProcessor::applyRestoredScalaTuning()
+{
+    juce::File scale, mapping;
+    {
+        const juce::ScopedLock sl (restoredScalaLock);
+        if (! hasRestoredScala)
+            return;
+        scale = restoredScaleFile;
+        mapping = restoredMappingFile;
+        hasRestoredScala = false;
+    }
+
+    if (scale != juce::File())
+        loadScalaTuning (scale, mapping);
+    else if (scalaScaleFile != juce::File())
+        clearScalaTuning();
+}
+
+void ChromakbdAudioProcessor::handleAsyncUpdate()
+{
+    applyRequestedProgram();
+    applyRestoredScalaTuning();
+}
+
+int ChromakbdAudioProcessor::getLowestVisibleKey() const noexcept
+{
+    return lowestVisibleKey.load();
+}
+
+void ChromakbdAudioProcessor::setLowestVisibleKey (int noteNumber)
+{
+    lowestVisibleKey = juce::jlimit (0, 127, noteNumber);
+}
+
+//==============================================================================
+void ChromakbdAudioProcessor::setFixedLatencyTiming (bool shouldUseFixedLatency)
+{
+    fixedLatencyTiming = shouldUseFixedLatency;
+}
+
+bool ChromakbdAudioProcessor::hasFixedLatencyTiming() const noexcept
+{
+    return fixedLatencyTiming.load();
+}
+
+juce::String ChromakbdAudioProcessor::openKeyReader (int index, const juce::File& device)
+{
+    return getKeyReader (index).open (device, true);
+}
+
+void ChromakbdAudioProcessor::closeKeyReader (int index)
+{
+    getKeyReader (index).close();
+}
+
+bool ChromakbdAudioProcessor::isKeyReaderOpen (int index) const
+{
+    return keyReaders[(size_t) index]->reader.isReading();
+}
+
+juce::File ChromakbdAudioProcessor::getKeyReaderDevice (int index) const
+{
+    return keyReaders[(size_t) index]->reader.getDevice();
+}
+
+EvdevKeyReader& ChromakbdAudioProcessor::getKeyReader (int index)
+{
+    jassert (juce::isPositiveAndBelow (index, maxKeyReaders));
+    return keyReaders[(size_t) index]->reader;
+}
+
+juce::String ChromakbdAudioProcessor::openJackOutput()
+{
+    return jackOutput.open (JucePlugin_Name);
+}
+
+void ChromakbdAudioProcessor::closeJackOutput()
+{
+    jackOutput.close();
+}
+
+bool ChromakbdAudioProcessor::isJackOutputOpen() const noexcept
+{
+    return jackOutput.isOpen();
+}
+
+juce::String ChromakbdAudioProcessor::getJackOutputPortName() const
+{
+    return jackOutput.getPortName();
+}
+
+int ChromakbdAudioProcessor::getNumMidiOverflows() const noexcept
+{
+    return numMidiOverflows.load();
 }
 
 //==============================================================================
@@ -1,18 +1,75 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "NoteEventQueue.h"
+#include "NoteStateSnapshot.h"
+#include "ChromaProgramBank.h"
+#include "EvdevKeyReader.h"
+#include "JackMidiOutput.h"
+#include "ChromaMpeOutput.h"
+#include "ChromaMtsOutput.h"
 
 //==============================================================================
 /**
 */
-class ChromakbdAudioProcessor  : public juce::AudioProcessor
+class ChromakbdAudioProcessor  : public juce::AudioProcessor,
+                                 private juce::AsyncUpdater
 {
 public:
     //==============================================================================
     ChromakbdAudioProcessor();
     ~ChromakbdAudioProcessor() override;
 
-    juce::MidiKeyboardState keyboardState;
+    // worst case for one block: every note on and off again on every channel
+    static constexpr int maxNoteEventsPerBlock = 128 * 16 * 2;
+
+    // a MidiBuffer stores each short message as a timestamp, a size and up to three bytes
+    static constexpr int bytesPerMidiEvent = (int) (sizeof (int32_t) + sizeof (uint16_t)) + 3;
+    static constexpr int maxTuningMessageBytes = (int) (sizeof (int32_t) + sizeof (uint16_t)) + ChromaMtsOutput::maxMessageBytes;
+
+    NoteEventQueue uiNoteEvents { maxNoteEventsPerBlock };      // notes played on the editor
+    NoteStateSnapshot noteStates;   // notes held in the output, for the editor to display
+
+    // Everything the host can automate. The editor and keyboard follow these
+    // through ParameterAttachments; the audio thread reads them through the
+    // getters below, which never lock.
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    juce::AudioProcessorValueTreeState parameters { *this, nullptr, "chromakbd", createParameterLayout() };
+
+    int getBase() const noexcept;
+    int getLayout() const noexcept;         // a ChromaKeyMap::Layout
+    int getKeyMapBase() const noexcept;
+    float getVelocity() const noexcept;
+    int getMidiChannel() const noexcept;
+    int getRangeStart() const noexcept;
+    int getRangeEnd() const noexcept;
+    bool isMpeEnabled() const noexcept;
+    ChromaMtsOutput::Mode getMtsMode() const noexcept;
+
+    ChromaProgramBank programs { ChromaProgramBank::createFactoryBank() };
+    juce::ChangeBroadcaster programChanges;     // for the editor, which applies the palette
+
+    // True on the message thread while a program's parameters are being
+    // set, one after another; the editor waits for programChanges and
+    // applies them all at once rather than rebuilding the keyboard for each.
+    bool isChangingProgram() const noexcept;
+
+    // Scala tunings, read on a background thread. Once loaded, a tuning
+    // replaces the equal divisions of base for MPE, MTS and the keyboard's
+    // colours. Message thread only.
+    void loadScalaTuning (const juce::File& scale, const juce::File& keyboardMapping = {});
+    void clearScalaTuning();
+    std::shared_ptr<const ChromaScala::Tuning> getScalaTuning() const;
+    juce::File getScalaScaleFile() const;
+    juce::File getScalaMappingFile() const;
+    juce::String getScalaError() const;     // from the last load
+
+    // a folder of .scl files, indexed in the background for browsing
+    void indexScalaFolder (const juce::File& folder);
+    juce::File getScalaFolder() const;
+    const juce::Array<ChromaScala::IndexEntry>& getScalaIndex() const;
+
+    juce::ChangeBroadcaster tuningChanges;      // a tuning has loaded, or a folder been indexed
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override;
@@ -47,7 +104,172 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) override;
     void setStateInformation (const void* data, int sizeInBytes) override;
 
+    // where the editor's keyboard is scrolled to, kept here so it's saved
+    int getLowestVisibleKey() const noexcept;
+    void setLowestVisibleKey (int noteNumber);
+
+    //==============================================================================
+    // When enabled, editor notes are played exactly one maximum-size block
+    // after they were played, instead of at the start of the next block.
+    void setFixedLatencyTiming (bool shouldUseFixedLatency);
+    bool hasFixedLatencyTiming() const noexcept;
+
+    // Plays keys straight from Linux input devices, bypassing the editor.
+    // Meant for the Standalone app, where nothing else is listening.
+    // Each reader can have its own zone; reader 0 normally follows the
+    // parameters. Returns an error message if the device can't be read.
+    static constexpr int maxKeyReaders = 4;
+    juce::String openKeyReader (int index, const juce::File& device);
+    void closeKeyReader (int index);
+    bool isKeyReaderOpen (int index) const;
+    juce::File getKeyReaderDevice (int index) const;
+    EvdevKeyReader& getKeyReader (int index);
+
+    // Standalone on Linux: plays notes to a JACK MIDI port from JACK's own
+    // callback, skipping the audio device. Returns an error message if
+    // there's no JACK server.
+    juce::String openJackOutput();
+    void closeJackOutput();
+    bool isJackOutputOpen() const noexcept;
+    juce::String getJackOutputPortName() const;
+
+    // Moves queued notes into midiMessages as one block of numSamples,
+    // starting at blockStartTime on the Time::getMillisecondCounterHiRes()
+    // clock. With steady timing each note lands latencySamples after it was
+    // played. Any input, the host's MIDI for this block, is merged in by
+    // sample position, its notes played like the keyboard's. Called by
+    // processBlock, or by the JACK output while it's open; a call that
+    // overlaps another only copies the input, leaving the notes queued.
+    void renderNoteEvents (juce::MidiBuffer& midiMessages, int numSamples, double sampleRate,
+                           int latencySamples, double blockStartTime, int byteBudget,
+                           const juce::MidiBuffer* input = nullptr);
+
+    // Events that didn't fit in their block's MIDI budget. Keyboard and
+    // device events are kept queued and played in a later block, each
+    // counted once however many blocks it waits; the host's own input can't
+    // wait, so what doesn't fit is dropped, and each message counted.
+    int getNumMidiOverflows() const noexcept;
+
 private:
+    std::atomic<float>* baseValue;
+    std::atomic<float>* layoutValue;
+    std::atomic<float>* keyMapBaseValue;
+    std::atomic<float>* velocityValue;
+    std::atomic<float>* midiChannelValue;
+    std::atomic<float>* rangeStartValue;
+    std::atomic<float>* rangeEndValue;
+    std::atomic<float>* mpeValue;
+    std::atomic<float>* mtsValue;
+
+    std::atomic<bool> fixedLatencyTiming { false };
+    std::atomic<int> lowestVisibleKey { 48 };
+    std::atomic<int> currentProgram { 0 };
+
+    // Hosts may switch programs from any thread, including the audio
+    // thread; the latest request is applied on the message thread.
+    std::atomic<int> requestedProgram { -1 };
+    bool changingProgram = false;
+    void applyRequestedProgram();
+    juce::CriticalSection programNamesLock;     // changeProgramName() may come from any thread too
+
+    // each reader pushes to its own queue, so none of them ever share one
+    struct KeyReaderSlot
+    {
+        explicit KeyReaderSlot (const ChromakbdAudioProcessor& p) : reader (p, events) {}
+
+        NoteEventQueue events { maxNoteEventsPerBlock };
+        EvdevKeyReader reader;
+    };
+    std::array<std::unique_ptr<KeyReaderSlot>, maxKeyReaders> keyReaders;
+
+    // every queue processBlock() merges, the editor's first
+    std::array<NoteEventQueue*, 1 + maxKeyReaders> noteSources;
+    std::atomic<bool> renderingNotes { false };
+
+    JackMidiOutput jackOutput { *this };
+
+    // MPE output, or MTS SysEx, in the base's N-EDO tuning. Their tables
+    // are rebuilt on the message thread whenever the tuning changes.
+    ChromaMpeOutput mpeOutput;
+    ChromaMtsOutput mtsOutput;
+    void updateTuning();
+    std::array<std::unique_ptr<juce::ParameterAttachment>, 2> tuningAttachments;
+
+    ChromaScalaLoader scalaLoader;
+    std::shared_ptr<const ChromaScala::Tuning> scalaTuning;
+    juce::File scalaScaleFile, scalaMappingFile, scalaFolder;
+    juce::String scalaError;
+
+    // Restored Scala files, from setStateInformation(), which hosts may call
+    // on any thread; they're loaded on the message thread.
+    juce::CriticalSection restoredScalaLock;
+    juce::File restoredScaleFile, restoredMappingFile;
+    bool hasRestoredScala = false;
+    void applyRestoredScalaTuning();
+
+    // program switches and restored Scala files, whichever are waiting
+    void handleAsyncUpdate() override;
+    juce::Array<ChromaScala::IndexEntry> scalaIndex;
+    bool mpeWasEnabled = false;     // as of the last rendered block
+    juce::MidiBuffer sourceMessages;    // the notes as played, for noteStates while MPE is on
+    juce::MidiBuffer hostMessages;      // this block's host input, swapped out of processBlock's buffer
+    juce::MidiBuffer spareMessages;     // stands in for host storage too small for the budget
+    const juce::MidiBuffer noInput;     // renderNoteEvents()' input when there isn't any
+
+    // The saved state is "CKBD", a format version byte, then records of a
+    // tag byte, a size byte and the data: a little-endian float, or for the
+    // Scala path tags, the path as UTF-8. Tags are never reused.
+    static constexpr int stateMagic = 0x44424b43;   // "CKBD", written little-endian
+    static constexpr juce::uint8 stateVersion = 1;
+
+    enum StateTag : juce::uint8
+    {
+        baseTag = 1,
+        layoutTag,
+        keyMapBaseTag,
+        velocityTag,
+        midiChannelTag,
+        rangeStartTag,
+        rangeEndTag,
+        lowestVisibleKeyTag,
+        fixedLatencyTimingTag,
+        programTag,
+        mpeTag,
+        mtsTag,
+        scalaScaleTag,      // a path, as UTF-8
+        scalaMappingTag,
+    };
+
+    struct StateParameter
+    {
+        StateTag tag;
+        const char* parameterID;
+    };
+
+    static constexpr StateParameter stateParameters[] = {
+        { baseTag,        "base" },
+        { layoutTag,      "layout" },
+        { keyMapBaseTag,  "keyMapBase" },
+        { velocityTag,    "velocity" },
+        { midiChannelTag, "midiChannel" },
+        { rangeStartTag,  "rangeStart" },
+        { rangeEndTag,    "rangeEnd" },
+        { mpeTag,         "mpe" },
+        { mtsTag,         "mts" },
+    };
+
+    // stateParameters' parameters, looked up once
+    std::array<juce::RangedAudioParameter*, std::size (stateParameters)> stateParameterPointers;
+
+    double currentSampleRate = 44100.0;
+    int maxBlockSize = 512;
+
+    // bytes of MidiBuffer storage set aside for one block, see prepareToPlay()
+    int midiByteBudget = 0;
+    std::atomic<int> numMidiOverflows { 0 };
+    const NoteEventQueue::Event* overflowedEvent = nullptr;    // the queue head last counted in it
+    bool mpeSwitchOverflowed = false;                           // an MPE switch waiting for room, counted
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChromakbdAudioProcessor)
 };